@@ -0,0 +1,139 @@
+/**
+ * Parameter lookup and update rates of datastore::store.
+ *
+ * The former design, a string keyed unordered_map of entries each owning
+ *  a heap allocated value, is reproduced here as the baseline. Both are
+ *  filled with the same parameters, then read and written in a shuffled
+ *  order : by name for the map, by handle and by name for the store.
+ *
+ * usage : bench-datastore [operations] [parameters]
+ */
+#include "datastore.hpp"
+#include "alloc-counter.hpp"
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+/** Baseline, one allocation per value, lookups hash the name **/
+struct legacy_entry {
+    std::string            name;
+    std::string            type;
+    std::vector<std::byte> value;
+
+    template <typename T> const T& get() const
+        { return *reinterpret_cast<const T*>(value.data()); }
+    template <typename T> void set(const T& t)
+    {
+        value.resize(sizeof(T));
+        *reinterpret_cast<T*>(value.data()) = t;
+    }
+};
+using legacy_map = std::unordered_map<std::string, legacy_entry>;
+
+template <typename Body>
+void measure(const char* name, std::size_t operations, Body&& body)
+{
+    body(); /**< warm up */
+
+    std::size_t allocs = sfx::alloc::count();
+    auto t0 = clock_type::now();
+    int64_t check = body();
+    double dt = std::chrono::duration<double>(clock_type::now() - t0).count();
+    allocs = sfx::alloc::count() - allocs;
+
+    std::cout << "  " << name << " : "
+              << operations / dt / 1e6 << " Mops/s "
+              << allocs << " allocs"
+              << " (" << check << ")" << std::endl;
+}
+
+}
+
+int main(int argc, char *const argv[])
+{
+    using namespace sfx;
+
+    std::size_t operations = 1 < argc ? std::atol(argv[1]) : 10000000;
+    std::size_t count = 2 < argc ? std::atol(argv[2]) : 64;
+
+    std::vector<std::string> names;
+    for (std::size_t i = 0; i < count; ++i)
+        names.push_back("pedalboard." + std::to_string(i / 8) + ".channel." + std::to_string(i % 8));
+
+    /* same random visit order for both */
+    std::vector<uint32_t> order(operations);
+    std::minstd_rand rng;
+    for (auto& o : order)
+        o = rng() % count;
+
+    std::size_t allocs = alloc::count();
+    legacy_map map;
+    for (const auto& n : names)
+    {
+        legacy_entry e{n, "int32", {}};
+        e.set<int32_t>(0);
+        map.emplace(n, std::move(e));
+    }
+    std::size_t map_allocs = alloc::count() - allocs;
+
+    allocs = alloc::count();
+    datastore::store store(count * sizeof(int32_t));
+    std::vector<datastore::handle<int32_t>> handles;
+    for (const auto& n : names)
+        handles.push_back(*store.add<int32_t>(n, 0));
+    std::size_t store_allocs = alloc::count() - allocs;
+
+    std::cout << count << " parameters, " << operations << " operations" << std::endl;
+    std::cout << "registration : map " << map_allocs << " allocs, store "
+              << store_allocs << " allocs, arena " << store.arena_size() << " bytes" << std::endl;
+
+    std::cout << "lookup" << std::endl;
+    measure("map by name    ", operations, [&]()
+    {
+        int64_t sum = 0;
+        for (auto i : order)
+            sum += map.find(names[i])->second.get<int32_t>();
+        return sum;
+    });
+    measure("store by name  ", operations, [&]()
+    {
+        int64_t sum = 0;
+        for (auto i : order)
+            sum += store.get(*store.find<int32_t>(names[i]));
+        return sum;
+    });
+    measure("store by handle", operations, [&]()
+    {
+        int64_t sum = 0;
+        for (auto i : order)
+            sum += store.get(handles[i]);
+        return sum;
+    });
+
+    std::cout << "update" << std::endl;
+    measure("map by name    ", operations, [&]()
+    {
+        int32_t v = 0;
+        for (auto i : order)
+            map.find(names[i])->second.set<int32_t>(++v);
+        return int64_t(v);
+    });
+    measure("store by handle", operations, [&]()
+    {
+        int32_t v = 0;
+        for (auto i : order)
+            store.set(handles[i], ++v);
+        return int64_t(v);
+    });
+    return 0;
+}
@@ -0,0 +1,144 @@
+/**
+ * Wakeup latency of the bridge event loop, time shared and in realtime mode.
+ *
+ * A reactor timer fires every period, as the bridge periodic work does,
+ *  and each wakeup is compared with its deadline. Meanwhile busy processes,
+ *  one per core, compete for the CPU at normal priority, and another one
+ *  keeps mapping and touching fresh memory. The same run is then repeated
+ *  after io::realtime::enter().
+ *
+ * usage : bench-jitter [seconds] [period_us] [cpu]
+ */
+#include "reactor.hpp"
+#include "realtime.hpp"
+#include "timing.hpp"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+using namespace sfx;
+
+/**
+ * Competing load, other processes of the machine at normal priority.
+ * Forked before the measures, so the memory lock of the realtime run
+ *  does not apply to them.
+ */
+class load {
+public:
+    explicit load(std::size_t busy)
+    {
+        for (std::size_t i = 0; i < busy; ++i)
+            spawn([]()
+            {
+                volatile uint64_t spin = 0;
+                for (;;)
+                    spin = spin + 1;
+            });
+        /* page faults and reclaim pressure */
+        spawn([]()
+        {
+            const std::size_t size = 16 << 20;
+            for (;;)
+            {
+                void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (p == MAP_FAILED)
+                    _exit(1);
+                std::memset(p, 1, size);
+                munmap(p, size);
+            }
+        });
+    }
+    ~load()
+    {
+        for (pid_t pid : _children)
+        {
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+        }
+    }
+
+private:
+    template <typename Fn> void spawn(Fn&& fn)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+            fn();
+        if (0 < pid)
+            _children.push_back(pid);
+    }
+
+    std::vector<pid_t> _children;
+};
+
+struct results {
+    midi::histogram late;   /**< per wakeup, in us */
+    uint64_t        missed; /**< periods elapsed without a wakeup */
+};
+
+/** Lateness of each timer wakeup over seconds **/
+results measure(double seconds, std::chrono::microseconds period)
+{
+    io::reactor loop;
+    loop.begin();
+    midi::histogram late;
+    uint64_t fired = 0, missed = 0;
+    auto start = clock_type::now();
+    auto end = start + std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(seconds));
+    loop.every(period, [&](uint64_t expirations)
+    {
+        auto now = clock_type::now();
+        fired += expirations;
+        missed += expirations - 1;
+        late.record(std::chrono::duration_cast<std::chrono::microseconds>(now - (start + fired * period)).count());
+        if (end <= now)
+            loop.stop();
+    });
+    loop.run();
+    return {late, missed};
+}
+
+void report(const char* name, const results& r)
+{
+    const auto& h = r.late;
+    std::cout << "  " << name << " : n=" << h.count()
+              << " p50=" << h.quantile(0.5) << "us"
+              << " p99=" << h.quantile(0.99) << "us"
+              << " p99.9=" << h.quantile(0.999) << "us"
+              << " max=" << h.max() << "us"
+              << " missed=" << r.missed << std::endl;
+}
+
+}
+
+int main(int argc, char *const argv[])
+{
+    double seconds = 1 < argc ? std::atof(argv[1]) : 5;
+    std::chrono::microseconds period(2 < argc ? std::atol(argv[2]) : 1000);
+    io::realtime::config rt;
+    rt.cpu = 3 < argc ? std::atoi(argv[3]) : 0;
+
+    std::size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << period.count() << "us period, " << seconds << "s, "
+              << cores << " busy processes" << std::endl;
+
+    load competing(cores);
+    report("time shared", measure(seconds, period));
+
+    auto r = io::realtime::enter(rt);
+    std::cout << "  realtime : " << r.str() << std::endl;
+    report("realtime   ", measure(seconds, period));
+    io::realtime::leave();
+    return 0;
+}
@@ -0,0 +1,148 @@
+/**
+ * Byte arrival to dispatch latency of the bridge event loop.
+ *
+ * A writer thread plays the pedalboard on the master side of a pty pair,
+ *  the bridge side opens the slave as a regular serial port and runs the
+ *  same reactor + parser pipeline as 5FX-Pedalboard.
+ * Messages carry their sequence number, lost and corrupt ones are
+ *  counted and do not skew the others ; the loop gives up a grace period
+ *  after the writer is done.
+ *
+ * usage : bench-latency [count] [interval_us]
+ */
+#include "serial-io.hpp"
+#include "reactor.hpp"
+#include "midi.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        clock_type::now().time_since_epoch()).count();
+}
+
+void report(const char* name, std::vector<int64_t>& samples)
+{
+    if (samples.empty())
+    {
+        std::cout << name << " : no samples" << std::endl;
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto at = [&](double q) { return samples[std::size_t(q * (samples.size() - 1))] / 1000.0; };
+    std::cout << name << " : n=" << samples.size()
+              << " min=" << at(0.0) << "us"
+              << " p50=" << at(0.5) << "us"
+              << " p99=" << at(0.99) << "us"
+              << " max=" << at(1.0) << "us" << std::endl;
+}
+
+}
+
+int main(int argc, char *const argv[])
+{
+    using namespace sfx;
+
+    std::size_t count = 1 < argc ? std::atoi(argv[1]) : 10000;
+    int interval = 2 < argc ? std::atoi(argv[2]) : 200;
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0)
+    {
+        perror("Failed create pty");
+        return -1;
+    }
+
+    io::serial serial;
+    if (io::serial::result::Ok != serial.begin({ptsname(master), 115200}))
+    {
+        perror("Failed open pty slave");
+        return -1;
+    }
+
+    midi::static_parser parser(midi::parser_capacity);
+    io::reactor loop;
+    loop.begin();
+
+    auto sent = std::make_unique<std::atomic<int64_t>[]>(count);
+    std::vector<int64_t> samples;
+    samples.reserve(count);
+    std::size_t next = 0; /**< Sequence number expected next */
+    std::size_t lost = 0;
+    std::size_t corrupt = 0;
+
+    loop.watch(serial.fd(), EPOLLIN, [&](uint32_t)
+    {
+        serial.receive_buffered();
+        for (auto raw = serial.buffered(); !raw.empty(); raw = serial.buffered())
+            serial.consume(parser.feed(raw, [&](const midi::message& msg)
+            {
+                /* 14 bits sequence, wrapped : the first match from next on */
+                std::size_t seq = (std::size_t(msg.data[0]) << 7) | std::size_t(msg.data[1]);
+                std::size_t skipped = (seq - next) & 0x3FFF;
+                if (count <= next + skipped || sent[next + skipped].load() == 0)
+                {
+                    /* not sent yet, bytes mangled on the way */
+                    corrupt += 1;
+                    return;
+                }
+                lost += skipped;
+                next += skipped;
+                samples.push_back(now_ns() - sent[next++].load());
+            }));
+    });
+
+    std::atomic<int64_t> finished{0};
+    std::thread writer([&]()
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            uint8_t msg[] = {0xC0, uint8_t((i >> 7) & 0x7F), uint8_t(i & 0x7F)};
+            sent[i].store(now_ns());
+            if (sizeof(msg) != write(master, msg, sizeof(msg)))
+                perror("write");
+            std::this_thread::sleep_for(std::chrono::microseconds(interval));
+        }
+        finished.store(now_ns());
+    });
+
+    const int64_t grace = std::chrono::nanoseconds(std::chrono::milliseconds(500)).count();
+    /* the pty is drained until the writer is done, it would block on a full one */
+    for (;;)
+    {
+        if (io::reactor::result::Ok != loop.run_once(50).first)
+            break;
+        int64_t end = finished.load();
+        if (end != 0 && (count <= next || grace < now_ns() - end))
+            break;
+    }
+    writer.join();
+    lost += count - next;
+
+    report("epoll reactor", samples);
+    if (lost != 0)
+        std::cout << "  lost " << lost << " of " << count << " messages" << std::endl;
+    if (corrupt != 0)
+        std::cout << "  corrupt " << corrupt << " messages" << std::endl;
+
+    serial.end();
+    close(master);
+    return 0;
+}
@@ -0,0 +1,79 @@
+/**
+ * Cost of recording io::metrics on the hot path.
+ *
+ * A writer thread updates a counter and a histogram in a tight loop, as
+ *  the reader and parser threads do per chunk and per message, first
+ *  alone then while another thread dumps registry snapshots back to back,
+ *  the worst an endpoint client can do. A shared atomic fetch_add is
+ *  measured as well for reference.
+ *
+ * usage : bench-metrics [iterations]
+ */
+#include "metrics.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+using namespace sfx;
+
+template <typename Body>
+double ns_per_op(std::size_t n, Body&& body)
+{
+    auto t0 = clock_type::now();
+    for (std::size_t i = 0; i < n; ++i)
+        body(i);
+    return std::chrono::duration<double, std::nano>(clock_type::now() - t0).count() / n;
+}
+
+void run(const char* name, std::size_t n, bool dumping)
+{
+    io::metrics::registry registry;
+    auto& count = registry.add_counter("bench.count");
+    auto& latency = registry.add_histogram("bench.latency");
+
+    std::atomic<bool> stop{false};
+    std::size_t dumps = 0;
+    std::thread reader;
+    if (dumping)
+        reader = std::thread([&]()
+        {
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                dumps += registry.snapshot().size() != 0;
+                registry.tick();
+            }
+        });
+
+    double c = ns_per_op(n, [&](std::size_t) { count.add(); });
+    double h = ns_per_op(n, [&](std::size_t i) { latency.record(int64_t(i & 0xFFFF)); });
+    std::atomic<uint64_t> shared{0};
+    double f = ns_per_op(n, [&](std::size_t) { shared.fetch_add(1, std::memory_order_relaxed); });
+
+    stop = true;
+    if (reader.joinable())
+        reader.join();
+    std::cout << "  " << name << " : counter " << c << "ns histogram " << h << "ns"
+              << " fetch_add " << f << "ns";
+    if (dumping)
+        std::cout << " (" << dumps << " snapshots)";
+    std::cout << std::endl;
+    if (count.value() != n)
+        std::cerr << "  lost increments : " << n - count.value() << std::endl;
+}
+
+}
+
+int main(int argc, char *const argv[])
+{
+    std::size_t n = 1 < argc ? std::atol(argv[1]) : 50000000;
+    std::cout << n << " updates per metric" << std::endl;
+    run("alone    ", n, false);
+    run("snapshots", n, true);
+    return 0;
+}
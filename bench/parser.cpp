@@ -0,0 +1,117 @@
+/**
+ * Throughput of io::parser on synthetic pedalboard streams.
+ *
+ * Streams are cut in fixed size chunks, as they would come out of the
+ *  serial port, and fed to the legacy operator() and to feed(), both with
+ *  the runtime protocol table and the compile time one.
+ *
+ * usage : bench-parser [stream_bytes] [chunk_bytes]
+ */
+#include "midi.hpp"
+#include "alloc-counter.hpp"
+
+#include <span>
+#include <chrono>
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+std::vector<std::byte> cc_stream(std::size_t size)
+{
+    std::vector<std::byte> v;
+    for (std::size_t i = 0; v.size() + 3 <= size; ++i)
+    {
+        v.push_back(std::byte(0xC0 | (i & 0x0F)));
+        v.push_back(std::byte(0x0B));
+        v.push_back(std::byte(i & 0x7F));
+    }
+    return v;
+}
+
+std::vector<std::byte> sysex_stream(std::size_t size)
+{
+    std::vector<std::byte> v;
+    for (std::size_t i = 0; v.size() + 18 <= size; ++i)
+    {
+        v.push_back(std::byte(0xF0));
+        for (std::size_t j = 0; j < 16; ++j)
+            v.push_back(std::byte((i + j) & 0x7F));
+        v.push_back(std::byte(0xF7));
+    }
+    return v;
+}
+
+template <typename Body>
+void measure(const char* name, std::size_t bytes, Body&& body)
+{
+    body(); /**< warm up */
+
+    std::size_t allocs = sfx::alloc::count();
+    auto t0 = clock_type::now();
+    std::size_t messages = body();
+    double dt = std::chrono::duration<double>(clock_type::now() - t0).count();
+    allocs = sfx::alloc::count() - allocs;
+
+    std::cout << "  " << name << " : "
+              << bytes / dt / 1e6 << " MB/s "
+              << messages / dt / 1e6 << " Mmsg/s "
+              << allocs << " allocs" << std::endl;
+}
+
+void run(const char* name, const std::vector<std::byte>& stream, std::size_t chunk)
+{
+    std::vector<std::vector<std::byte>> chunks;
+    for (std::size_t i = 0; i < stream.size(); i += chunk)
+        chunks.emplace_back(
+            stream.begin() + i,
+            stream.begin() + std::min(i + chunk, stream.size()));
+
+    std::cout << name << " (" << stream.size() << " bytes, chunks of " << chunk << ")" << std::endl;
+
+    sfx::midi::parser legacy(sfx::midi::protocol(), sfx::midi::parser_capacity);
+    measure("operator()", stream.size(), [&]()
+    {
+        std::size_t count = 0;
+        for (const auto& c : chunks)
+            count += legacy(c).size();
+        return count;
+    });
+
+    sfx::midi::parser streaming(sfx::midi::protocol(), sfx::midi::parser_capacity);
+    measure("feed      ", stream.size(), [&]()
+    {
+        std::size_t count = 0;
+        auto sink = [&count](const sfx::midi::message&) { ++count; };
+        std::span<const std::byte> s(stream);
+        for (std::size_t i = 0; i < s.size(); i += chunk)
+            streaming.feed(s.subspan(i, std::min(chunk, s.size() - i)), sink);
+        return count;
+    });
+
+    sfx::midi::static_parser fixed(sfx::midi::parser_capacity);
+    measure("static    ", stream.size(), [&]()
+    {
+        std::size_t count = 0;
+        auto sink = [&count](const sfx::midi::message&) { ++count; };
+        std::span<const std::byte> s(stream);
+        for (std::size_t i = 0; i < s.size(); i += chunk)
+            fixed.feed(s.subspan(i, std::min(chunk, s.size() - i)), sink);
+        return count;
+    });
+}
+
+}
+
+int main(int argc, char *const argv[])
+{
+    std::size_t size = 1 < argc ? std::atoi(argv[1]) : 16 << 20;
+    std::size_t chunk = 2 < argc ? std::atoi(argv[2]) : 64;
+
+    run("CC stream", cc_stream(size), chunk);
+    run("SysEx stream", sysex_stream(size), chunk);
+    return 0;
+}
@@ -0,0 +1,106 @@
+/**
+ * Steady state cost of io::serial receive paths.
+ *
+ * Small messages are written on the master side of a pty pair and read
+ *  back from the slave with each receive flavour. Heap allocations are
+ *  counted through the alloc-counter hook once warmed up.
+ *
+ * usage : bench-receive [iterations]
+ */
+#include "serial-io.hpp"
+#include "alloc-counter.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <functional>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+/** Run body iterations times after warm up, report allocations and timing **/
+void measure(const char* name, int master, int slave, std::size_t iterations,
+    const std::function<std::size_t()>& body)
+{
+    const uint8_t msg[] = {0xC0, 0x04, 0x01};
+    std::size_t received = 0;
+    auto once = [&]()
+    {
+        if (sizeof(msg) != write(master, msg, sizeof(msg)))
+            perror("write");
+        pollfd pfd{slave, POLLIN, 0};
+        poll(&pfd, 1, 1000);
+        received += body();
+    };
+
+    for (std::size_t i = 0; i < 1000; ++i)
+        once();
+
+    received = 0;
+    std::size_t allocs = sfx::alloc::count();
+    auto t0 = clock_type::now();
+    for (std::size_t i = 0; i < iterations; ++i)
+        once();
+    auto dt = clock_type::now() - t0;
+    allocs = sfx::alloc::count() - allocs;
+
+    std::cout << name << " : "
+              << std::chrono::duration<double, std::nano>(dt).count() / iterations << "ns/iter "
+              << double(allocs) / iterations << " allocs/iter "
+              << received << " bytes" << std::endl;
+}
+
+}
+
+int main(int argc, char *const argv[])
+{
+    using namespace sfx;
+
+    std::size_t iterations = 1 < argc ? std::atoi(argv[1]) : 100000;
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0)
+    {
+        perror("Failed create pty");
+        return -1;
+    }
+
+    io::serial serial;
+    if (io::serial::result::Ok != serial.begin({ptsname(master), 115200}))
+    {
+        perror("Failed open pty slave");
+        return -1;
+    }
+
+    measure("receive(hint)", master, serial.fd(), iterations, [&]()
+    {
+        auto [code, msg] = serial.receive(64);
+        return msg.size();
+    });
+
+    std::array<std::byte, 64> storage;
+    measure("receive(span)", master, serial.fd(), iterations, [&]()
+    {
+        auto [code, msg] = serial.receive(storage);
+        return msg.size();
+    });
+
+    measure("receive_buffered", master, serial.fd(), iterations, [&]()
+    {
+        auto [code, n] = serial.receive_buffered();
+        for (auto view = serial.buffered(); !view.empty(); view = serial.buffered())
+            serial.consume(view.size());
+        return n;
+    });
+
+    serial.end();
+    close(master);
+    return 0;
+}
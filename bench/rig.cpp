@@ -0,0 +1,179 @@
+/**
+ * CPU cost of the multi board bridge against the number of boards.
+ *
+ * Each board is a pty pair. A feeder thread plays the boards : it presents
+ *  them, then writes footswitch and expression updates on every master at
+ *  a fixed rate per board. The rig runs on the main thread as the bridge
+ *  does and its thread CPU time is reported, per second and per message.
+ * Half way, the first board is unplugged : the others must lose nothing.
+ *
+ * usage : bench-rig [seconds] [msgs/s per board]
+ */
+#include "device.hpp"
+#include "reactor.hpp"
+#include "transport.hpp"
+
+#include <ctime>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <cstdlib>
+#include <iostream>
+#include <unordered_map>
+
+#include <unistd.h>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+using namespace sfx;
+
+double thread_seconds()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/** Board side of every pty, on its own thread **/
+class feeder {
+public:
+    feeder(std::vector<std::unique_ptr<io::pty>>& boards, double rate)
+        : _boards(boards), _rate(rate), _written(boards.size(), 0)
+    {}
+
+    /** Present every board, then play traffic until stop(), unplug the first at half **/
+    void run(clock_type::time_point unplug)
+    {
+        std::byte buffer[midi::sysex_capacity + 2];
+        midi::message present = midi::command(sysex::Present, {'5', 'F', 'X'});
+        std::size_t n = midi::encode(present, buffer);
+        for (auto& b : _boards)
+            if (ssize_t(n) != write(b->fd(), buffer, n))
+                perror("present");
+
+        const uint8_t msgs[][3] = {{0xC0, 0x04, 0x01}, {0xC0, 0x0B, 0x40}, {0xC1, 0x2B, 0x10}};
+        std::vector<std::byte> burst;
+        auto start = clock_type::now();
+        std::size_t sent = 0;
+        while (!_stop.load(std::memory_order_relaxed))
+        {
+            auto now = clock_type::now();
+            if (unplug <= now && _boards[0])
+                _boards[0].reset();
+
+            /* same count of messages on every board, written at once per tick */
+            std::size_t due = std::size_t(std::chrono::duration<double>(now - start).count() * _rate);
+            burst.clear();
+            for (; sent < due; ++sent)
+                for (uint8_t b : msgs[sent % 3])
+                    burst.push_back(std::byte(b));
+            for (std::size_t i = 0; i < _boards.size(); ++i)
+            {
+                if (!_boards[i])
+                    continue;
+                /* host requests are drained and ignored */
+                std::byte sink[256];
+                while (0 < read(_boards[i]->fd(), sink, sizeof(sink)))
+                    continue;
+                ssize_t w = burst.empty() ? 0 : write(_boards[i]->fd(), burst.data(), burst.size());
+                if (0 < w)
+                    _written[i] += w;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    void stop() { _stop = true; }
+
+    /** Complete messages written on board i **/
+    std::size_t sent(std::size_t i) const { return _written[i] / 3; }
+
+private:
+    std::vector<std::unique_ptr<io::pty>>& _boards;
+    double                   _rate;
+    std::vector<std::size_t> _written;
+    std::atomic<bool>        _stop{false};
+};
+
+void run(std::size_t count, double seconds, double rate)
+{
+    std::vector<std::unique_ptr<io::pty>> boards;
+    io::reactor loop;
+    loop.begin();
+    io::rig rig(loop);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        boards.push_back(io::pty::try_open());
+        if (!boards.back())
+        {
+            perror("Failed create pty");
+            return;
+        }
+        io::device::config cfg;
+        cfg.port = boards.back()->peer();
+        cfg.baudrate = int(sysex::baudrates[0]);
+        rig.add(std::move(cfg));
+    }
+
+    /* devices never move, index them once */
+    std::vector<std::size_t> received(count, 0);
+    std::unordered_map<const io::device*, std::size_t> index;
+    for (std::size_t i = 0; i < count; ++i)
+        index.emplace(&rig[i], i);
+    rig.on_message([&](io::device& d, const midi::message&) { received[index[&d]] += 1; });
+    loop.after_dispatch([&]() { rig.transmit(); });
+    rig.begin();
+
+    auto t0 = clock_type::now();
+    auto end = t0 + std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(seconds));
+    feeder f(boards, rate);
+    std::thread feeding([&]() { f.run(t0 + (end - t0) / 2); });
+
+    while (rig.ready() < count && clock_type::now() < t0 + std::chrono::seconds(2))
+        loop.run_once(10);
+    if (rig.ready() < count)
+        std::cerr << "  only " << rig.ready() << " boards identified" << std::endl;
+
+    std::size_t rounds = 0;
+    double cpu0 = thread_seconds();
+    auto w0 = clock_type::now();
+    for (auto now = w0; now < end; now = clock_type::now())
+        rounds += 0 < loop.run_once(10).second;
+    f.stop();
+    feeding.join();
+    /* let the bytes in flight arrive */
+    while (0 < loop.run_once(50).second)
+        ++rounds;
+    double cpu = thread_seconds() - cpu0;
+    double wall = std::chrono::duration<double>(clock_type::now() - w0).count();
+
+    std::size_t total = 0, lost = 0;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        total += received[i];
+        if (i != 0 && received[i] < f.sent(i))
+            lost += f.sent(i) - received[i];
+    }
+    std::cout << "  " << count << " boards : "
+              << total / wall << " msg/s "
+              << "cpu " << 100. * cpu / wall << "% "
+              << 1e6 * cpu / (total ? total : 1) << "us/msg "
+              << rounds / wall << " wakeups/s "
+              << "unplugged " << (io::device::status::Closed == rig[0].state() ? "yes" : "no")
+              << " others lost " << lost << std::endl;
+}
+
+}
+
+int main(int argc, char *const argv[])
+{
+    double seconds = 1 < argc ? std::atof(argv[1]) : 2;
+    double rate = 2 < argc ? std::atof(argv[2]) : 500;
+
+    std::cout << rate << " msgs/s per board, " << seconds << "s" << std::endl;
+    for (std::size_t count : {1, 8, 32})
+        run(count, seconds, rate);
+    return 0;
+}
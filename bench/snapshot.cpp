@@ -0,0 +1,146 @@
+/**
+ * Reader contention on the published pedalboard state.
+ *
+ * One writer thread publishes datastore::board states as fast as it can,
+ *  like the bridge after each parsed batch, while N reader threads copy the
+ *  latest one in a loop. Every field of a published state is derived from
+ *  its batch number, so readers can tell a torn copy. The longest publish
+ *  tells whether the writer ever waited on a reader.
+ *
+ * io::snapshot is compared with a mutex guarded copy of the same state.
+ *
+ * usage : bench-snapshot [seconds] [max_readers]
+ */
+#include "snapshot.hpp"
+#include "state.hpp"
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+using sfx::datastore::board;
+
+board make_state(uint64_t batch)
+{
+    board b;
+    b.batch = batch;
+    b.switches = uint16_t(batch & 0xFF);
+    b.leds_on = uint16_t(~batch & 0xFF);
+    b.exprs = {uint16_t(batch & 0x3FFF), uint16_t((batch >> 1) & 0x3FFF)};
+    b.params_size = board::params_capacity;
+    for (std::size_t i = 0; i < b.params.size(); ++i)
+        b.params[i] = std::byte(batch + i);
+    return b;
+}
+
+bool consistent(const board& b)
+{
+    return b.switches == uint16_t(b.batch & 0xFF)
+        && b.leds_on == uint16_t(~b.batch & 0xFF)
+        && b.exprs[1] == uint16_t((b.batch >> 1) & 0x3FFF)
+        && b.params.back() == std::byte(b.batch + b.params.size() - 1);
+}
+
+/** Baseline, every access takes the lock **/
+class locked {
+public:
+    explicit locked(const board& init) : _state(init) {}
+
+    void publish(const board& b) { std::lock_guard lock(_mutex); _state = b; }
+    std::size_t read(board& b) const { std::lock_guard lock(_mutex); b = _state; return 0; }
+
+private:
+    mutable std::mutex _mutex;
+    board              _state;
+};
+
+struct results {
+    double publishes;  /**< per second */
+    double worst;      /**< longest publish, in us */
+    double reads;      /**< per second, all readers */
+    double retries;    /**< per read */
+    std::size_t torn;  /**< inconsistent copies */
+};
+
+template <typename Shared>
+results run(std::size_t readers, double seconds)
+{
+    /* readers may copy before the first publish, the seed is consistent too */
+    Shared shared(make_state(0));
+    std::atomic<bool> stop{false};
+    std::atomic<std::size_t> reads{0}, retries{0}, torn{0};
+
+    std::vector<std::thread> threads;
+    for (std::size_t r = 0; r < readers; ++r)
+        threads.emplace_back([&]()
+        {
+            board b;
+            std::size_t n = 0, k = 0, t = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                k += shared.read(b);
+                t += !consistent(b);
+                ++n;
+            }
+            reads += n;
+            retries += k;
+            torn += t;
+        });
+
+    /* a state is prepared per publish, as the bridge tracks messages */
+    uint64_t batch = 0;
+    clock_type::duration worst{};
+    auto t0 = clock_type::now();
+    auto end = t0 + std::chrono::duration<double>(seconds);
+    for (auto now = t0; now < end;)
+    {
+        board b = make_state(++batch);
+        now = clock_type::now();
+        shared.publish(b);
+        worst = std::max(worst, clock_type::now() - now);
+    }
+    double dt = std::chrono::duration<double>(clock_type::now() - t0).count();
+    stop = true;
+    for (auto& t : threads)
+        t.join();
+
+    return {batch / dt, std::chrono::duration<double, std::micro>(worst).count(),
+            reads / dt, reads ? double(retries) / reads : 0, torn};
+}
+
+template <typename Shared>
+void report(const char* name, std::size_t max_readers, double seconds)
+{
+    std::cout << name << std::endl;
+    for (std::size_t n = 0; n <= max_readers; n = n ? n * 2 : 1)
+    {
+        auto r = run<Shared>(n, seconds);
+        std::cout << "  " << n << " readers : "
+                  << r.publishes / 1e6 << " Mpub/s "
+                  << "worst " << r.worst << "us "
+                  << r.reads / 1e6 << " Mreads/s "
+                  << r.retries << " retries/read "
+                  << r.torn << " torn" << std::endl;
+    }
+}
+
+}
+
+int main(int argc, char *const argv[])
+{
+    double seconds = 1 < argc ? std::atof(argv[1]) : 0.5;
+    std::size_t max_readers = 2 < argc ? std::atoi(argv[2]) : 8;
+
+    std::cout << "board state : " << sizeof(board) << " bytes" << std::endl;
+    report<sfx::io::snapshot<board>>("snapshot", max_readers, seconds);
+    report<locked>("mutex", max_readers, seconds);
+    return 0;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
 
 namespace hw
 {
@@ -77,4 +78,34 @@ namespace hw
     }
   };
 
+  /** Fixed size FIFO, indices wrap on 8 bits **/
+  template <typename T, uint8_t Size>
+  class ring
+  {
+  public:
+    static_assert(Size != 0 && (Size & (Size - 1)) == 0, "ring size must be a power of 2");
+
+    bool is_empty() const { return _head == _tail; }
+    bool is_full() const { return static_cast<uint8_t>(_head - _tail) == Size; }
+
+    /** false when full, val is dropped **/
+    bool push(const T &val)
+    {
+      if (is_full())
+        return false;
+      _storage[_head++ % Size] = val;
+      return true;
+    }
+
+    const T &front() const { return _storage[_tail % Size]; }
+    void pop() { _tail += 1; }
+
+    void clear() { _head = _tail = 0; }
+
+  private:
+    T _storage[Size];
+    uint8_t _head = 0;
+    uint8_t _tail = 0;
+  };
+
 }
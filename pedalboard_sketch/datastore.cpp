@@ -1,5 +1,8 @@
 #include "datastore.hpp"
 #include "io.hpp"
+#include "scanner.hpp"
+#include "sampler.hpp"
+#include "framebuffer.hpp"
 
 namespace datastore
 {
@@ -8,91 +11,143 @@ namespace datastore
   {
     this->cfg = cfg;
     /* retrieve initial values */
-    switches.fill([](int16_t i)
-                  {
-          int pin = harddefs::switch_pin(i);
-          pinMode(pin, INPUT_PULLUP);
-          return footswitch{i, static_cast<footswitch::state>(digitalRead(pin))}; });
+    for (uint8_t i = 0; i < harddefs::channels_count; ++i)
+      pinMode(harddefs::switch_pin(i), INPUT_PULLUP);
+    scanner::begin();
+    switch_levels = scanner::levels();
+    switches.fill([this](int16_t i)
+                  { return footswitch{int8_t(i), static_cast<footswitch::state>((switch_levels >> i) & 1), 0}; });
     exprs.fill([](int16_t i)
-               { return expr{i, expr::state::Disabled,
-                             static_cast<uint16_t>(analogRead(harddefs::expr_pin(i)))}; });
+               { return expr{int8_t(i), expr::state::Disabled,
+                             static_cast<uint16_t>(analogRead(harddefs::expr_pin(i)) << (sampler::bits - 10)), 0}; });
+    expr_targets.fill([this](int16_t i)
+                      { return exprs[i].value; });
+    expr_stamps.fill([](int16_t)
+                     { return micros(); });
+    expr_timers.fill([](int16_t)
+                     { return millis(); });
+    sampler::begin();
     leds.fill([](int16_t i)
-              {
-          pinMode(harddefs::led_pin(i), OUTPUT);
-          return led{i, led::state::Off}; });
-    debounce_sw_timers.fill([](int16_t)
-                            { return millis(); });
+              { return led{int8_t(i), led::state::Off}; });
+    framebuffer::begin();
+    changed = 0;
+    switch_events.clear();
+    switches_overflow = 0;
+    exprs_pending = 0;
+    expr_turn = 0;
     /* update */
     // push_changes();
   }
 
   void global::begin_frame()
   {
-    for (auto &sw : switches)
-      sw.reset_changed();
-    for (auto &led : leds)
-      led.reset_changed();
-    for (auto &ex : exprs)
-      ex.reset_changed();
+    changed = 0;
   }
 
   void global::read_inputs()
   {
-    /** Switches **/
+    /** Switches, already debounced by the scanner **/
+    uint8_t levels = scanner::levels();
+    for (uint8_t m = levels ^ switch_levels; m != 0; m &= m - 1)
+    {
+      uint8_t i = __builtin_ctz(m);
+      footswitch &sw = set_switch(i);
+      sw.s = (levels >> i) & 1 ? footswitch::state::Pressed : footswitch::state::Released;
+      sw.at = scanner::changed_at(i);
+    }
+    switch_levels = levels;
+    /** Expressions, sampled in background, filtered and rate limited **/
     unsigned long t = millis();
-    for (auto &sw : switches)
+    for (auto &ex : exprs)
     {
-      /** Pass during debouncing **/
-      if ((t - debounce_sw_timers[sw.get().id]) < cfg->debounce_sw_duration)
-        continue;
-
-      auto v = digitalRead(harddefs::switch_pin(sw.get().id));
-      auto s = v == HIGH ? footswitch::state::Pressed : footswitch::state::Released;
-      if (s != sw.get().s)
+      uint16_t v;
+      uint16_t &target = expr_targets[ex.id];
+      if (sampler::read(ex.id, v))
       {
-        sw.set().s = s;
-        debounce_sw_timers[sw.get().id] = t;
+        /* ignore moves within noise, except to reach the ends */
+        uint16_t delta = v < target ? target - v : v - target;
+        if (cfg->expression_hysteresis <= delta || ((v == 0 || v == sampler::max_value) && v != target))
+        {
+          target = v;
+          expr_stamps[ex.id] = micros();
+        }
       }
+      if (ex.s == expr::state::Disabled || target == ex.value || (t - expr_timers[ex.id]) < cfg->expression_period_ms)
+        continue;
+      expr &e = set_expr(ex.id);
+      e.value = target;
+      e.at = expr_stamps[ex.id];
+      expr_timers[ex.id] = t;
     }
-    /** Expressions **/
-    for (auto &ex : exprs)
+  }
+
+  void global::show_leds() const
+  {
+    uint8_t on = 0, blink = 0;
+    for (const auto &l : leds)
     {
-      if (ex.get().s == expr::state::Disabled)
-        continue;
-      auto v = static_cast<uint16_t>(analogRead(harddefs::expr_pin(ex.get().id)));
-      if (v != ex.get().value)
-        ex.set().value = v;
+      if (l.s == led::state::On)
+        on |= 1 << l.id;
+      else if (l.s == led::state::Blink)
+        blink |= 1 << l.id;
     }
+    framebuffer::show(on, blink);
   }
 
-  void global::push_changes() const
+  void global::push_changes(io::frame &out, size_t room)
   {
-    for (const auto &sw : switches)
+    /* LEDs are shown as a whole frame, whatever the number changed */
+    const mask_type leds_mask = ((mask_type(1) << harddefs::channels_count) - 1) << bits::leds;
+    if (changed & leds_mask)
+      show_leds();
+
+    /* switches left out by a full ring come first, as older changes ;
+       a switch changed meanwhile is queued once, in its latest state */
+    uint8_t waiting = switches_overflow | uint8_t((changed >> bits::switches) & ((1 << harddefs::channels_count) - 1));
+    switches_overflow = 0;
+    for (uint8_t m = waiting; m != 0; m &= m - 1)
     {
-      if (!sw.changed())
-        continue;
-      io::write(0xC0 | sw.get().id, cfg->footswitch_cc, sw.get().s);
-      io::print("SW changed : ", sw.get().id, " : ", static_cast<int>(sw.get().s));
-      // digitalWrite(harddefs::led_pin(sw.get().id), static_cast<int>(sw.get().s));
+      uint8_t i = __builtin_ctz(m);
+      if (!switch_events.push(switches[i]))
+        switches_overflow |= 1 << i;
     }
-    for (const auto &l : leds)
+    exprs_pending |= uint8_t(changed >> bits::exprs);
+
+    size_t queued = room < uart::tx_size ? uart::tx_size - room : 0;
+    size_t budget = room;
+    if (io::frame::capacity < budget)
+      budget = io::frame::capacity;
+    uint8_t record = cfg->debug ? io::event_size : 0;
+
+    /* switches first, they are rare and latency matters */
+    while (!switch_events.is_empty() && out.size() + 3 + record <= budget)
     {
-      if (!l.changed())
-        continue;
-      int state = l.get().s == led::state::On ? HIGH : LOW;
-      digitalWrite(harddefs::led_pin(l.get().id), state);
+      const footswitch &sw = switch_events.front();
+      out.cc(sw.id, cfg->footswitch_cc, sw.s);
+      if (cfg->debug)
+        out.event(sysex::Switch, sw.id, sw.s, sw.at);
+      switch_events.pop();
     }
-    for (const auto &ex : exprs)
+
+    /* pedals with room left, a pedal waiting keeps only its last value,
+       the first pedal served rotates so none starves */
+    size_t backlog = cfg->expression_backlog;
+    if (budget < backlog)
+      backlog = budget;
+    expr_turn = (expr_turn + 1) % harddefs::exprs_count;
+    for (uint8_t n = 0; n < harddefs::exprs_count && queued + out.size() + 6 + record <= backlog; ++n)
     {
-      if (!ex.changed())
+      uint8_t i = (expr_turn + n) % harddefs::exprs_count;
+      if (!(exprs_pending & (1 << i)))
         continue;
-      /* convert 10 bits value to 14 bits */
-      uint16_t val16 = ex.get().value << (14 - 10);
-      uint8_t msb = (val16 & (0x007F << 7)) >> 7;
-      uint8_t lsb = (val16 & 0x007F);
-      io::write(0xC0 | ex.get().id, cfg->expression_cc, msb);
-      io::write(0xC0 | ex.get().id, cfg->expression_cc + 0x20, lsb);
-      io::print("Expr changed : ", ex.get().id, " : ", static_cast<int>(ex.get().value));
+      const expr &ex = exprs[i];
+      /* convert sampled value to 14 bits */
+      uint16_t val16 = ex.value << (14 - sampler::bits);
+      out.cc(ex.id, cfg->expression_cc, (val16 >> 7) & 0x7F);
+      out.cc(ex.id, cfg->expression_cc + 0x20, val16 & 0x7F);
+      if (cfg->debug)
+        out.event(sysex::Expression, ex.id, ex.value, ex.at);
+      exprs_pending &= ~(1 << i);
     }
   }
 
@@ -100,18 +155,17 @@ namespace datastore
   {
     for (const auto &sw : switches)
     {
-      io::print("SW : ", sw.get().id,
-                " : ", harddefs::switch_pin(sw.get().id),
-                " : ", debounce_sw_timers[sw.get().id],
-                " : ", static_cast<int>(sw.get().s));
+      io::print("SW : ", sw.id,
+                " : ", harddefs::switch_pin(sw.id),
+                " : ", static_cast<int>(sw.s));
     }
     for (const auto &led : leds)
     {
-      io::print("Led : ", led.get().id, " : ", static_cast<int>(led.get().s));
+      io::print("Led : ", led.id, " : ", static_cast<int>(led.s));
     }
     for (const auto &ex : exprs)
     {
-      io::print("Expr : ", ex.get().id, " : ", static_cast<int>(ex.get().value));
+      io::print("Expr : ", ex.id, " : ", static_cast<int>(ex.value));
     }
   }
 }
@@ -5,6 +5,11 @@
 
 #include <stdint.h>
 
+namespace io
+{
+  class frame;
+}
+
 namespace datastore
 {
   /** Struct definitions **/
@@ -19,6 +24,7 @@ namespace datastore
     };
     int8_t id;
     state s;
+    unsigned long at; /**< micros() when the change was detected */
   };
 
   struct led
@@ -44,7 +50,8 @@ namespace datastore
     };
     int8_t id;
     state s;
-    uint16_t value; /**< 10 bits value */
+    uint16_t value;   /**< 12 bits value, see sampler */
+    unsigned long at; /**< micros() when value was sampled */
   };
 
   struct config
@@ -53,48 +60,83 @@ namespace datastore
     uint8_t expression_cc = 0x0B;
     uint8_t led_cc = 0x03;
 
-    uint32_t debounce_sw_duration = 50; /**< 50ms */
+    uint8_t expression_hysteresis = 8; /**< minimal move reported, in 12 bits steps */
+    uint8_t expression_period_ms = 10; /**< minimal delay between updates of a pedal */
+    uint8_t expression_backlog = 24;   /**< bytes pedals may keep queued on the UART */
+
+    uint8_t baudrate = 0; /**< index in sysex::baudrates */
+    bool debug = false;   /**< send event records along with changes */
   };
 
-  template <typename T>
-  class entry
+  /** Position of each entry in global::changed **/
+  namespace bits
   {
-  public:
-    entry(const T &val = T()) : _value(val), _changed(true)
-    {
-    }
-
-    T &set()
-    {
-      _changed = true;
-      return _value;
-    }
-    const T &get() const { return _value; }
-
-    bool changed() const { return _changed; }
-    void reset_changed() { _changed = false; }
-
-  private:
-    T _value;
-    bool _changed; /**< True if state has changed at last frame */
-  };
+    static constexpr const uint8_t switches = 0;
+    static constexpr const uint8_t leds = switches + harddefs::channels_count;
+    static constexpr const uint8_t exprs = leds + harddefs::channels_count;
+    static constexpr const uint8_t count = exprs + harddefs::exprs_count;
+  }
+  /** One bit per entry, unsigned long is 32 bits wide on AVR **/
+  using mask_type = unsigned long;
+  static_assert(bits::count <= 32, "changes mask too narrow");
 
   struct global
   {
-    hw::array<entry<footswitch>, harddefs::channels_count> switches;
-    hw::array<entry<led>, harddefs::channels_count> leds;
-    hw::array<entry<expr>, harddefs::exprs_count> exprs;
-    hw::array<unsigned long, harddefs::channels_count> debounce_sw_timers;
+    hw::array<footswitch, harddefs::channels_count> switches;
+    hw::array<led, harddefs::channels_count> leds;
+    hw::array<expr, harddefs::exprs_count> exprs;
+    uint8_t switch_levels; /**< Debounced switch levels at last frame, bit per switch */
+    hw::array<uint16_t, harddefs::exprs_count> expr_targets;     /**< Last sampled values past hysteresis */
+    hw::array<unsigned long, harddefs::exprs_count> expr_stamps; /**< Detection time of each target */
+    hw::array<unsigned long, harddefs::exprs_count> expr_timers; /**< Last update of each pedal */
+
+    mask_type changed; /**< Entries changed at last frame, see bits */
+
+    /** Outbound scheduling **/
+    hw::ring<footswitch, harddefs::switch_events_size> switch_events; /**< Switch changes not sent yet, in order */
+    uint8_t switches_overflow;                                        /**< Switches whose change found the ring full */
+    uint8_t exprs_pending;                                            /**< Pedals whose value was not sent yet */
+    uint8_t expr_turn;                                                /**< Pedal served first */
 
     const config *cfg;
 
     void init(const config *cfg);
 
+    /** Mutable access, flags the entry as changed **/
+    footswitch &set_switch(uint8_t i)
+    {
+      mark(bits::switches + i);
+      return switches[i];
+    }
+    led &set_led(uint8_t i)
+    {
+      mark(bits::leds + i);
+      return leds[i];
+    }
+    expr &set_expr(uint8_t i)
+    {
+      mark(bits::exprs + i);
+      return exprs[i];
+    }
+
     void begin_frame();
     void read_inputs();
-    void push_changes() const;
+    /**
+     * Apply LED changes and serialize pending inputs into out, within
+     *  the room left on the UART. Switch events are sent first and in
+     *  order, a switch that found the ring full is queued again on the
+     *  next frames with its latest state; pedals only send their latest value, and only while fewer
+     *  than expression_backlog bytes are queued, so a switch event never
+     *  waits long behind them.
+     */
+    void push_changes(io::frame &out, size_t room);
 
     /** debug method used to send whole datastore in one call **/
     void dump() const;
+
+  private:
+    void mark(uint8_t bit) { changed |= mask_type(1) << bit; }
+    /** Render every LED state to the framebuffer **/
+    void show_leds() const;
   };
 }
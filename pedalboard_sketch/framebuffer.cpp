@@ -0,0 +1,89 @@
+#include "framebuffer.hpp"
+#include "harddefs.hpp"
+
+namespace framebuffer
+{
+  namespace
+  {
+    /** LED bitmap split by port, LEDs are wired on ports B and D only **/
+    struct ports
+    {
+      uint8_t b;
+      uint8_t d;
+    };
+
+    ports mask;           /**< bits driving a LED */
+    ports lit;            /**< LEDs steadily on */
+    ports blinking;       /**< LEDs blinking */
+    volatile bool phase;  /**< blinking LEDs are lit */
+
+    ports to_ports(uint8_t leds)
+    {
+      ports p = {0, 0};
+      for (uint8_t i = 0; i < harddefs::channels_count; ++i)
+      {
+        if (!(leds & (1 << i)))
+          continue;
+        unsigned int pin = harddefs::led_pin(i);
+        uint8_t bit = 1 << harddefs::pin_bit(pin);
+        if (harddefs::pin_port(pin) == harddefs::PortB)
+          p.b |= bit;
+        else
+          p.d |= bit;
+      }
+      return p;
+    }
+
+    /** Write both ports, other pins of the ports are left untouched **/
+    void render()
+    {
+      uint8_t b = lit.b | (phase ? blinking.b : 0);
+      uint8_t d = lit.d | (phase ? blinking.d : 0);
+      PORTB = (PORTB & ~mask.b) | b;
+      PORTD = (PORTD & ~mask.d) | d;
+    }
+  }
+
+  /** Called from the timer interrupt **/
+  void blink()
+  {
+    phase = !phase;
+    if (blinking.b | blinking.d)
+      render();
+  }
+
+  void begin()
+  {
+    mask = to_ports((1 << harddefs::channels_count) - 1);
+    lit = ports{0, 0};
+    blinking = ports{0, 0};
+    phase = false;
+
+    noInterrupts();
+    DDRB |= mask.b;
+    DDRD |= mask.d;
+    render();
+    /* CTC mode, clk/1024, compare match every blink_period_ms */
+    TCCR1A = 0;
+    TCCR1B = (1 << WGM12) | (1 << CS12) | (1 << CS10);
+    OCR1A = F_CPU / 1024 * harddefs::blink_period_ms / 1000 - 1;
+    TIMSK1 = 1 << OCIE1A;
+    interrupts();
+  }
+
+  void show(uint8_t on, uint8_t blink)
+  {
+    ports l = to_ports(on);
+    ports k = to_ports(blink);
+    noInterrupts();
+    lit = l;
+    blinking = k;
+    render();
+    interrupts();
+  }
+}
+
+ISR(TIMER1_COMPA_vect)
+{
+  framebuffer::blink();
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * LEDs framebuffer.
+ * The state of every LED is kept as port masks and written to PORTB and
+ *  PORTD in one go, instead of a digitalWrite per LED. A Timer1 compare
+ *  interrupt flips the blink phase, so blinking LEDs need no traffic from
+ *  the host nor work from the main loop.
+ */
+namespace framebuffer
+{
+  /** Set LED pins as outputs, all off, and start Timer1 **/
+  void begin();
+
+  /** Show a frame, bit i of on lights LED i, bit i of blink makes it blink **/
+  void show(uint8_t on, uint8_t blink);
+}
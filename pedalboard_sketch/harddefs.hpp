@@ -16,6 +16,24 @@ namespace harddefs
   constexpr int led_pin(unsigned int i) { return 2 + leds_pins[i]; }
   constexpr int switch_pin(unsigned int i) { return switches_pins[channels_count - i - 1]; }
 
+  /** AVR port of Uno/Nano digital pins : 0-7 on D, 8-13 on B, A0-A5 on C */
+  enum port : uint8_t
+  {
+    PortB = 0,
+    PortC = 1,
+    PortD = 2,
+  };
+  constexpr port pin_port(unsigned int pin) { return pin < 8 ? PortD : pin < 14 ? PortB : PortC; }
+  constexpr uint8_t pin_bit(unsigned int pin) { return pin < 8 ? pin : pin < 14 ? pin - 8 : pin - 14; }
+
+  /** switches sampling period of the scanner, in microseconds */
+  static constexpr const unsigned int scan_period_us = 1000;
+  /** consecutive identical samples for a switch to change state */
+  static constexpr const uint8_t debounce_samples = 4;
+
+  /** time blinking LEDs spend on, then off, in milliseconds */
+  static constexpr const unsigned int blink_period_ms = 250;
+
   /** number of expression pedals */
   static constexpr const uint8_t exprs_count = 2;
 
@@ -25,8 +43,12 @@ namespace harddefs
   /** return hardware pin of given expression pedal */
   constexpr int expr_pin(unsigned int i) { return exprs_pins[i]; }
 
+  /** Name sent in the presentation SysEx **/
+  static constexpr const char *name = "5FX-Pedalboard:001";
+
   /** Other constants **/
-  static constexpr const size_t serial_buffer_size = 128;
+  /** switch events waiting for room on the UART */
+  static constexpr const uint8_t switch_events_size = 16;
 
   static constexpr const size_t inputs_count = channels_count + exprs_count;
   static constexpr const size_t outputs_count = channels_count + exprs_count;
@@ -4,13 +4,39 @@
 #define _IO_HPP_
 
 #include <stdint.h>
+#include <string.h>
+
+#include "sysex.hpp"
+#include "harddefs.hpp"
+#include "uart.hpp"
 
 namespace io
 {
   namespace impl
   {
+    inline void print(const char *str) { uart::write(reinterpret_cast<const uint8_t *>(str), strlen(str)); }
+    inline void print(char c) { uart::write(static_cast<uint8_t>(c)); }
+    inline void print(unsigned long n)
+    {
+      uint8_t digits[10];
+      uint8_t *d = digits + sizeof(digits);
+      do
+      {
+        *--d = '0' + n % 10;
+        n /= 10;
+      } while (n != 0);
+      uart::write(d, digits + sizeof(digits) - d);
+    }
+    inline void print(long n)
+    {
+      if (n < 0)
+        uart::write('-');
+      /* negated unsigned, -n overflows for LONG_MIN */
+      print(n < 0 ? 0UL - static_cast<unsigned long>(n) : static_cast<unsigned long>(n));
+    }
+    /** Other integers, in decimal **/
     template <typename T>
-    void print(T t) { Serial.print(t); }
+    void print(T t) { print(static_cast<long>(t)); }
     template <typename T, typename... Ts>
     void print(T t, Ts... ts)
     {
@@ -19,18 +45,24 @@ namespace io
     }
   }
 
+  /** Start a pedalboard SysEx **/
+  inline void sysex_begin(uint8_t cmd)
+  {
+    const uint8_t head[] = {sysex::start, sysex::manufacturer[0], sysex::manufacturer[1], cmd};
+    uart::write(head, sizeof(head));
+  }
+
   template <typename... Ts>
   void print(Ts... ts)
   {
-    const uint8_t head[] = {0x70, 0x7D, 0x02};
-    Serial.write(head, 3);
-    impl::print<Ts...>(ts...);
-    Serial.write('\n');
-    Serial.write(0xF7);
+    sysex_begin(sysex::Print);
+    impl::print(ts...);
+    uart::write('\n');
+    uart::write(sysex::end);
   }
 
   template <typename T>
-  void write(T t) { Serial.write(t); }
+  void write(T t) { uart::write(static_cast<uint8_t>(t)); }
   template <typename T, typename... Ts>
   void write(T t, Ts... ts)
   {
@@ -38,12 +70,91 @@ namespace io
     write(ts...);
   }
 
-  static void present(const char *name)
+  inline void present(const char *name)
+  {
+    sysex_begin(sysex::Present);
+    uart::write(reinterpret_cast<const uint8_t *>(name), strlen(name));
+    uart::write(sysex::end);
+  }
+
+  /** Size of an event record **/
+  static constexpr const size_t event_size = sysex::header_size + 6 + sysex::time_size;
+
+  /**
+   * Outbound bytes of a loop iteration.
+   * Changes are serialized here and handed to the UART in a single write,
+   *  large enough for every input changing in the same frame.
+   */
+  class frame
+  {
+  public:
+    static constexpr const size_t capacity =
+        harddefs::channels_count * 3 + harddefs::exprs_count * 6 + harddefs::inputs_count * event_size;
+
+    size_t size() const { return _size; }
+
+    void clear() { _size = 0; }
+
+    void cc(uint8_t channel, uint8_t cc, uint8_t val)
+    {
+      push(0xC0 | channel);
+      push(cc);
+      push(val);
+    }
+
+    /** Compact binary debug record, value on 14 bits, time of detection in micros **/
+    void event(uint8_t kind, uint8_t id, uint16_t value, unsigned long time)
+    {
+      push(sysex::start);
+      push(sysex::manufacturer[0]);
+      push(sysex::manufacturer[1]);
+      push(sysex::Event);
+      push(kind);
+      push(id);
+      push((value >> 7) & 0x7F);
+      push(value & 0x7F);
+      push((time >> 21) & 0x7F);
+      push((time >> 14) & 0x7F);
+      push((time >> 7) & 0x7F);
+      push(time & 0x7F);
+      push(sysex::end);
+    }
+
+    /** Hand the frame to the UART, does not wait for transmission **/
+    void send()
+    {
+      if (_size != 0)
+        uart::write(_data, _size);
+      _size = 0;
+    }
+
+  private:
+    void push(uint8_t b) { _data[_size++] = b; }
+
+    uint8_t _data[capacity];
+    size_t _size = 0;
+  };
+
+  /** Answer a ping with the board clock, sent right away **/
+  inline void pong(uint8_t sequence)
+  {
+    unsigned long time = micros();
+    const uint8_t msg[] = {
+        sysex::start, sysex::manufacturer[0], sysex::manufacturer[1], sysex::Ping,
+        sequence,
+        uint8_t((time >> 21) & 0x7F), uint8_t((time >> 14) & 0x7F),
+        uint8_t((time >> 7) & 0x7F), uint8_t(time & 0x7F),
+        sysex::end};
+    uart::write(msg, sizeof(msg));
+  }
+
+  /** Acknowledge a link speed change, sent at the former rate **/
+  inline void baudrate(uint8_t index)
   {
-    const uint8_t head[] = {0x70, 0x7D, 0x01};
-    Serial.write(head, 3);
-    Serial.write(name);
-    Serial.write(0xF7);
+    const uint8_t msg[] = {
+        sysex::start, sysex::manufacturer[0], sysex::manufacturer[1], sysex::Baudrate,
+        index, sysex::end};
+    uart::write(msg, sizeof(msg));
   }
 }
 
@@ -6,6 +6,8 @@
 #include "array.hpp"
 #include "datastore.hpp"
 #include "io.hpp"
+#include "sysex.hpp"
+#include "uart.hpp"
 
 namespace datastore
 {
@@ -16,13 +18,8 @@ namespace datastore
 namespace io
 {
 
-  /** Serial Storage **/
-  using serial_storage_type = hw::array<uint8_t, harddefs::serial_buffer_size>;
-  static serial_storage_type serial_raw_storage;
-
-  /** Serial buffer **/
-  using serial_buffer_type = hw::vector<serial_storage_type, &serial_raw_storage>;
-  static serial_buffer_type serial_buffer;
+  /** Outbound frame, sent once per loop **/
+  static frame out;
 
   /** Parser status **/
   enum class status
@@ -34,64 +31,139 @@ namespace io
   };
   static status serial_status;
 
+  /** CC being received **/
+  static uint8_t cc_bytes[3];
+  static uint8_t cc_size;
+
+  /** SysEx being received, parsed as it streams in, never buffered whole **/
+  static constexpr const uint8_t sysex_args_size = 4;
+  struct sysex_message
+  {
+    uint16_t size;                 /**< bytes received after 0xF0 */
+    bool ours;                     /**< manufacturer id matches */
+    uint8_t cmd;
+    uint8_t args[sysex_args_size]; /**< first arguments, enough for every command */
+  };
+  static sysex_message sysex_in;
+
+  /** CC handlers, validate then apply, invalid messages are dropped and
+   *  reported in debug mode **/
+
+  void reject_cc(const char *what, uint8_t channel, uint8_t val)
+  {
+    if (datastore::configs.debug)
+      io::print("Rejected ", what, " CC : ", channel, " : ", val);
+  }
+
+  void ignore_cc(uint8_t, uint8_t) {}
+
+  void led_cc(uint8_t channel, uint8_t val)
+  {
+    if (harddefs::channels_count <= channel || datastore::led::state::Count <= val)
+      return reject_cc("LED", channel, val);
+    datastore::globals.set_led(channel).s = static_cast<datastore::led::state>(val);
+  }
+
+  void expression_cc(uint8_t channel, uint8_t val)
+  {
+    if (harddefs::exprs_count <= channel || datastore::expr::state::Count <= val)
+      return reject_cc("expression", channel, val);
+    datastore::globals.set_expr(channel).s = static_cast<datastore::expr::state>(val);
+  }
+
+  using cc_handler = void (*)(uint8_t channel, uint8_t val);
+
+  enum cc_command : uint8_t
+  {
+    IgnoreCC = 0,
+    LedCC = 1,
+    ExpressionCC = 2,
+  };
+  static const cc_handler cc_handlers[] = {ignore_cc, led_cc, expression_cc};
+
+  /** Command of each CC number, a byte per entry rather than a pointer to spare RAM **/
+  static uint8_t cc_commands[128];
+
+  void build_cc_commands(const datastore::config &cfg)
+  {
+    memset(cc_commands, IgnoreCC, sizeof(cc_commands));
+    cc_commands[cfg.led_cc & 0x7F] = LedCC;
+    cc_commands[cfg.expression_cc & 0x7F] = ExpressionCC;
+  }
+
   /** Processing methods **/
 
-  void process_cc()
+  void process_cc(uint8_t channel, uint8_t cc, uint8_t val)
   {
-    uint8_t channel = serial_buffer[0] & 0x0F;
-    uint8_t cc = serial_buffer[1];
-    uint8_t val = serial_buffer[2];
+    cc_handlers[cc_commands[cc]](channel, val);
+  }
 
-    io::print("Accepted CC : ", channel, " : ", cc, " : ", val);
+  void process_sysex()
+  {
+    /* F0 manufacturer[2] command args... F7 */
+    if (!sysex_in.ours || sysex_in.size < sysex::header_size)
+      return;
 
-    if (cc == datastore::configs.led_cc)
+    uint8_t cmd = sysex_in.cmd;
+    uint16_t argc = sysex_in.size - sysex::header_size;
+    if (cmd == sysex::Present)
     {
-      if (harddefs::channels_count <= channel)
-      {
-        io::print("Rejected Invalid Channel : ", channel);
-        return;
-      }
-      if (val < 0 || datastore::led::state::Count <= val)
-      {
-        io::print("Rejected Invalid Value : ", val);
-        return;
-      }
-      datastore::globals.leds[channel].set().s = static_cast<datastore::led::state>(val);
+      io::present(harddefs::name);
     }
-    else if (cc == datastore::configs.expression_cc)
+    else if (cmd == sysex::Baudrate && argc == 1)
     {
-      if (harddefs::exprs_count <= channel)
+      uint8_t index = sysex_in.args[0];
+      if (sysex::baudrates_count <= index)
       {
-        io::print("Rejected Invalid Channel : ", channel);
+        io::baudrate(datastore::configs.baudrate);
         return;
       }
-      if (val < 0 || datastore::led::state::Count <= val)
+      /* ack at the former rate then switch */
+      io::baudrate(index);
+      uart::flush();
+      uart::begin(sysex::baudrates[index]);
+      datastore::configs.baudrate = index;
+    }
+    else if (cmd == sysex::Debug && argc == 1)
+    {
+      datastore::configs.debug = sysex_in.args[0] != 0;
+    }
+    else if (cmd == sysex::Ping && argc == 1)
+    {
+      io::pong(sysex_in.args[0]);
+    }
+    else if (cmd == sysex::Leds && argc == 2 * sysex::leds_bitmap_size)
+    {
+      const uint8_t *args = sysex_in.args;
+      uint16_t on = args[0] | (args[1] << 7);
+      uint16_t blink = args[2] | (args[3] << 7);
+      for (uint8_t i = 0; i < harddefs::channels_count; ++i)
       {
-        io::print("Rejected Invalid Value : ", val);
-        return;
+        datastore::led::state s = datastore::led::state::Off;
+        if (blink & (1 << i))
+          s = datastore::led::state::Blink;
+        else if (on & (1 << i))
+          s = datastore::led::state::On;
+        if (datastore::globals.leds[i].s != s)
+          datastore::globals.set_led(i).s = s;
       }
-      datastore::globals.exprs[channel].set().s = static_cast<datastore::expr::state>(val);
     }
   }
-  void process_sysex()
-  {
-    io::print("AcceptedSysex");
-  }
 
   /** Parsing methods **/
 
   void accept_first_byte(uint8_t b)
   {
-
-    serial_buffer.clear();
     if ((b & 0xF0) == 0xC0)
     {
-      serial_buffer.push_back(b);
+      cc_bytes[0] = b;
+      cc_size = 1;
       serial_status = status::ReceivingCC;
     }
-    else if (b == 0xF0)
+    else if (b == sysex::start)
     {
-      serial_buffer.push_back(b);
+      sysex_in.size = 0;
+      sysex_in.ours = true;
       serial_status = status::ReceivingSysex;
     }
     else
@@ -109,35 +181,45 @@ namespace io
     }
     else
     {
-      serial_buffer.push_back(b);
-      if (serial_buffer.size == 3)
+      cc_bytes[cc_size++] = b;
+      if (cc_size == 3)
       {
-        process_cc();
+        process_cc(cc_bytes[0] & 0x0F, cc_bytes[1], cc_bytes[2]);
         serial_status = status::Ok;
       }
     }
   }
 
-  void accept_sysex_byte(uint8_t b)
+  /** A run of SysEx data bytes, of any length **/
+  void accept_sysex_data(const uint8_t *data, uint8_t n)
   {
-    if ((b & 0x80) && b != 0xF7)
+    /* header */
+    for (; n != 0 && sysex_in.size < sysex::header_size; --n, ++data)
     {
-      accept_first_byte(b);
-      /** TODO notify error **/
+      if (sysex_in.size < sizeof(sysex::manufacturer))
+        sysex_in.ours = sysex_in.ours && *data == sysex::manufacturer[sysex_in.size];
+      else
+        sysex_in.cmd = *data;
+      sysex_in.size += 1;
+    }
+    /* arguments, only the first ones are kept */
+    uint16_t argc = sysex_in.size - sysex::header_size;
+    for (uint8_t i = 0; sysex_in.ours && i < n && argc + i < sysex_args_size; ++i)
+      sysex_in.args[argc + i] = data[i];
+    sysex_in.size += n;
+  }
+
+  void accept_sysex_end(uint8_t b)
+  {
+    if (b == sysex::end)
+    {
+      process_sysex();
+      serial_status = status::Ok;
     }
     else
     {
-      if (serial_buffer.is_full())
-      {
-        /** TODO notify error **/
-        serial_status = status::Rejected;
-      }
-      serial_buffer.push_back(b);
-      if (b == 0xF7)
-      {
-        process_sysex();
-        serial_status = status::Ok;
-      }
+      accept_first_byte(b);
+      /** TODO notify error **/
     }
   }
 
@@ -153,46 +235,58 @@ namespace io
     }
   }
 
-  void process_serial_in()
+  /** Parse received bytes where they lie **/
+  void accept(const uint8_t *data, uint8_t n)
   {
-    while (0 < Serial.available())
+    const uint8_t *end = data + n;
+    while (data != end)
     {
-      /* get input */
-      int rb = Serial.read();
-      if (rb < 0)
+      if (serial_status == status::ReceivingSysex)
       {
+        /* SysEx data is handed over as a whole run */
+        const uint8_t *run = data;
+        while (data != end && !(*data & 0x80))
+          ++data;
+        accept_sysex_data(run, data - run);
+        if (data != end)
+          accept_sysex_end(*data++);
         continue;
       }
-      /* process it */
-      else
+
+      uint8_t b = *data++;
+      switch (serial_status)
       {
-        uint8_t b = rb;
-        //        Serial.print("Accept byte : ");
-        //        Serial.print((int)rb);
-        //        Serial.print(" : ");
-        //        Serial.println((int)b);
-        switch (serial_status)
-        {
-
-        case status::Ok:
-          accept_first_byte(b);
-          break;
-
-        case status::ReceivingCC:
-          accept_cc_byte(b);
-          break;
-
-        case status::ReceivingSysex:
-          accept_sysex_byte(b);
-          break;
-
-        case status::Rejected:
-          reject_byte(b);
-          break;
-        }
+
+      case status::Ok:
+        accept_first_byte(b);
+        break;
+
+      case status::ReceivingCC:
+        accept_cc_byte(b);
+        break;
+
+      case status::ReceivingSysex:
+        break;
+
+      case status::Rejected:
+        reject_byte(b);
+        break;
       }
     }
   }
+
+  void process_serial_in()
+  {
+    /* the ring may wrap once, later bytes wait for the next loop */
+    for (uint8_t i = 0; i < 2; ++i)
+    {
+      uart::span in = uart::readable();
+      if (in.size == 0)
+        break;
+      accept(in.data, in.size);
+      uart::consume(in.size);
+    }
+  }
 }
 
 void setup()
@@ -200,21 +294,19 @@ void setup()
 
   /** Hardware setup **/
 
-  Serial.begin(9600);
+  uart::begin(sysex::baudrates[datastore::configs.baudrate]);
 
   datastore::globals.init(&datastore::configs);
   // datastore::globals.dump();
 
-  io::serial_raw_storage.fill([](int)
-                              { return 0; });
-  io::serial_buffer.clear();
+  io::build_cc_commands(datastore::configs);
   io::serial_status = io::status::Ok;
 
   /** beautiful animation **/
 
   /** Send presentation */
 
-  io::present("5FX-Pedalboard:001");
+  io::present(harddefs::name);
 }
 
 void loop()
@@ -223,8 +315,8 @@ void loop()
   datastore::globals.begin_frame();
   io::process_serial_in();
   datastore::globals.read_inputs();
-  datastore::globals.push_changes();
-  Serial.flush();
+  datastore::globals.push_changes(io::out, uart::available_for_write());
+  io::out.send();
   //*/
 
   /*
@@ -0,0 +1,64 @@
+#include "sampler.hpp"
+#include "harddefs.hpp"
+
+namespace sampler
+{
+  namespace
+  {
+    uint8_t current;             /**< pedal being converted */
+    uint8_t count;               /**< conversions summed for current */
+    uint16_t sum;
+
+    volatile uint16_t values[harddefs::exprs_count];
+    volatile uint8_t fresh;      /**< bit i set when values[i] is unread */
+
+    /** AVcc reference, channel of pedal i **/
+    void select(uint8_t i)
+    {
+      ADMUX = (1 << REFS0) | ((harddefs::expr_pin(i) - A0) & 0x07);
+    }
+  }
+
+  /** Called from the ADC interrupt **/
+  void convert()
+  {
+    sum += ADC;
+    if (++count == oversampling)
+    {
+      values[current] = sum >> decimation;
+      fresh |= 1 << current;
+      sum = 0;
+      count = 0;
+      current = (current + 1) % harddefs::exprs_count;
+      select(current);
+    }
+    ADCSRA |= 1 << ADSC;
+  }
+
+  void begin()
+  {
+    current = 0;
+    count = 0;
+    sum = 0;
+    fresh = 0;
+    select(current);
+    /* clk/128 : 125kHz ADC clock, ~9600 conversions/s */
+    ADCSRA = (1 << ADEN) | (1 << ADIE) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+    ADCSRA |= 1 << ADSC;
+  }
+
+  bool read(uint8_t i, uint16_t &value)
+  {
+    noInterrupts();
+    bool ok = fresh & (1 << i);
+    value = values[i];
+    fresh &= ~(1 << i);
+    interrupts();
+    return ok;
+  }
+}
+
+ISR(ADC_vect)
+{
+  sampler::convert();
+}
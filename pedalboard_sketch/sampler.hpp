@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Expression pedals sampler.
+ * Conversions are chained from the ADC complete interrupt, cycling through
+ *  harddefs::exprs_pins. Each pedal value is the decimated sum of
+ *  `oversampling` conversions, which buys 2 bits of resolution over a
+ *  single conversion.
+ */
+namespace sampler
+{
+  /** Conversions summed per value, 4^n for n extra bits **/
+  static constexpr const uint8_t oversampling_bits = 4;
+  static constexpr const uint8_t oversampling = 1 << oversampling_bits;
+  /** Resolution of published values, sums are decimated to it **/
+  static constexpr const uint8_t bits = 12;
+  static constexpr const uint8_t decimation = 10 + oversampling_bits - bits;
+  static constexpr const uint16_t max_value = (1023 << oversampling_bits) >> decimation;
+
+  /** Start the conversion chain, analogRead must not be used afterward **/
+  void begin();
+
+  /** Latest value of pedal i, false when none was published since last call **/
+  bool read(uint8_t i, uint16_t &value);
+}
@@ -0,0 +1,87 @@
+#include "scanner.hpp"
+#include "harddefs.hpp"
+
+namespace scanner
+{
+  namespace
+  {
+    /** Samples a switch must hold before its level is trusted **/
+    static constexpr const uint8_t window = (1 << harddefs::debounce_samples) - 1;
+
+    uint8_t history[harddefs::channels_count]; /**< last samples, newest in bit 0 */
+    volatile uint8_t stable;                    /**< debounced levels */
+    unsigned long stamps[harddefs::channels_count]; /**< time of last change */
+
+    /** Raw levels of every switch, from a single read of each port **/
+    uint8_t sample()
+    {
+      const uint8_t ports[] = {PINB, PINC, PIND};
+      uint8_t raw = 0;
+      for (uint8_t i = 0; i < harddefs::channels_count; ++i)
+      {
+        unsigned int pin = harddefs::switch_pin(i);
+        if (ports[harddefs::pin_port(pin)] & (1 << harddefs::pin_bit(pin)))
+          raw |= 1 << i;
+      }
+      return raw;
+    }
+  }
+
+  /** Called from the timer interrupt **/
+  void scan()
+  {
+    uint8_t raw = sample();
+    uint8_t s = stable;
+    for (uint8_t i = 0; i < harddefs::channels_count; ++i)
+    {
+      uint8_t h = history[i] = (history[i] << 1) | ((raw >> i) & 1);
+      if ((h & window) == window)
+        s |= 1 << i;
+      else if ((h & window) == 0)
+        s &= ~(1 << i);
+    }
+    /* the clock is only read when something changed */
+    if (s != stable)
+    {
+      unsigned long now = micros();
+      for (uint8_t m = s ^ stable; m != 0; m &= m - 1)
+        stamps[__builtin_ctz(m)] = now;
+    }
+    stable = s;
+  }
+
+  void begin()
+  {
+    uint8_t raw = sample();
+    for (uint8_t i = 0; i < harddefs::channels_count; ++i)
+      history[i] = raw & (1 << i) ? 0xFF : 0x00;
+    stable = raw;
+    unsigned long now = micros();
+    for (uint8_t i = 0; i < harddefs::channels_count; ++i)
+      stamps[i] = now;
+
+    /* CTC mode, clk/64, compare match every scan_period_us */
+    noInterrupts();
+    TCCR2A = 1 << WGM21;
+    TCCR2B = 1 << CS22;
+    OCR2A = F_CPU / 64 / (1000000UL / harddefs::scan_period_us) - 1;
+    TIMSK2 = 1 << OCIE2A;
+    interrupts();
+  }
+
+  uint8_t levels() { return stable; }
+
+  unsigned long changed_at(uint8_t i)
+  {
+    /* 4 bytes, not read atomically on AVR */
+    noInterrupts();
+    unsigned long t = stamps[i];
+    interrupts();
+    return t;
+  }
+}
+
+ISR(TIMER2_COMPA_vect)
+{
+  scanner::scan();
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Footswitches scanner.
+ * A Timer2 compare interrupt samples the switch ports at a fixed rate and
+ *  feeds a shift register debouncer per switch. The main loop only reads
+ *  the debounced levels and never waits on inputs.
+ */
+namespace scanner
+{
+  /** Seed the debouncers with current levels and start Timer2 **/
+  void begin();
+
+  /** Debounced levels, bit i set while switch i reads HIGH **/
+  uint8_t levels();
+
+  /** micros() at the last debounced change of switch i **/
+  unsigned long changed_at(uint8_t i);
+}
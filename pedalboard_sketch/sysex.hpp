@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Pedalboard specific SysEx, shared by the firmware and the host bridge.
+ * Every message is framed as : 0xF0 manufacturer[2] command args... 0xF7
+ */
+namespace sysex
+{
+  static constexpr const uint8_t start = 0xF0;
+  static constexpr const uint8_t end = 0xF7;
+  static constexpr const uint8_t manufacturer[2] = {0x70, 0x7D};
+
+  /** Length of the header following start **/
+  static constexpr const uint8_t header_size = 3;
+
+  enum command : uint8_t
+  {
+    Present = 0x01,  /**< board -> host : name ; host -> board : who are you */
+    Print = 0x02,    /**< board -> host : ASCII text */
+    Baudrate = 0x03, /**< host -> board : rate index ; board -> host : rate in effect */
+    Event = 0x04,    /**< board -> host : kind id value_msb value_lsb time[4] */
+    Debug = 0x05,    /**< host -> board : 0 disables, 1 enables event records */
+    Leds = 0x06,     /**< host -> board : on[2] blink[2], state of every LED at once */
+    Ping = 0x07,     /**< host -> board : sequence ; board -> host : sequence time[4] */
+  };
+
+  /** Event record kinds **/
+  enum event_kind : uint8_t
+  {
+    Switch = 0x01,
+    Expression = 0x02,
+  };
+
+  /**
+   * Board timestamps, micros() truncated to 28 bits and sent on four
+   *  7 bits bytes, most significant first. They wrap every 268s.
+   */
+  static constexpr const uint8_t time_size = 4;
+  static constexpr const uint32_t time_mask = (1UL << (7 * time_size)) - 1;
+
+  /**
+   * LED bitmaps of the Leds command, bit i stands for LED i.
+   * Each bitmap is split over two 7 bits bytes, low bits first.
+   */
+  static constexpr const uint8_t leds_bitmap_size = 2;
+
+  /** Link speeds, indexed by the Baudrate argument, first one is used at boot **/
+  static constexpr const uint8_t baudrates_count = 4;
+  static constexpr const uint32_t baudrates[baudrates_count] = {115200, 250000, 500000, 1000000};
+}
@@ -0,0 +1,129 @@
+#include "uart.hpp"
+
+#include <Arduino.h>
+#include <avr/cpufunc.h>
+
+namespace uart
+{
+  namespace
+  {
+    static_assert(rx_size <= 128 && (rx_size & (rx_size - 1)) == 0, "rx_size must be a power of 2");
+    static_assert(tx_size <= 128 && (tx_size & (tx_size - 1)) == 0, "tx_size must be a power of 2");
+
+    uint8_t rx_storage[rx_size];
+    volatile uint8_t rx_head;      /**< written by the RX interrupt */
+    volatile uint8_t rx_tail;      /**< written by the reader */
+    volatile uint16_t rx_overruns;
+
+    uint8_t tx_storage[tx_size];
+    volatile uint8_t tx_head;      /**< written by write() */
+    volatile uint8_t tx_tail;      /**< written by the UDRE interrupt */
+  }
+
+  /** Called from the RX complete interrupt **/
+  void receive()
+  {
+    uint8_t b = UDR0;
+    uint8_t head = rx_head;
+    if (static_cast<uint8_t>(head - rx_tail) == rx_size)
+    {
+      rx_overruns = rx_overruns + 1;
+      return;
+    }
+    rx_storage[head % rx_size] = b;
+    rx_head = head + 1;
+  }
+
+  /** Called from the data register empty interrupt **/
+  void transmit()
+  {
+    uint8_t tail = tx_tail;
+    /* write() may enable the interrupt after the ring was drained */
+    if (tail == tx_head)
+    {
+      UCSR0B = UCSR0B & ~(1 << UDRIE0);
+      return;
+    }
+    UDR0 = tx_storage[tail % tx_size];
+    /* clear TXC0 so flush() waits for this byte */
+    UCSR0A = (UCSR0A & (1 << U2X0)) | (1 << TXC0);
+    tx_tail = ++tail;
+    if (tail == tx_head)
+      UCSR0B = UCSR0B & ~(1 << UDRIE0);
+  }
+
+  void begin(uint32_t baudrate)
+  {
+    /* double speed, exact for every rate of sysex::baudrates but 115200 (2.1%) */
+    UBRR0 = (F_CPU / 8 + baudrate / 2) / baudrate - 1;
+    UCSR0A = 1 << U2X0;
+    UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);
+    UCSR0B = (1 << RXEN0) | (1 << TXEN0) | (1 << RXCIE0);
+  }
+
+  void flush()
+  {
+    while ((UCSR0B & (1 << UDRIE0)) || !(UCSR0A & (1 << TXC0)))
+      _NOP();
+  }
+
+  span readable()
+  {
+    uint8_t tail = rx_tail;
+    uint8_t count = rx_head - tail;
+    uint8_t offset = tail % rx_size;
+    if (rx_size - offset < count)
+      count = rx_size - offset;
+    return span{rx_storage + offset, count};
+  }
+
+  void consume(uint8_t n) { rx_tail = rx_tail + n; }
+
+  uint16_t overruns()
+  {
+    noInterrupts();
+    uint16_t n = rx_overruns;
+    interrupts();
+    return n;
+  }
+
+  uint8_t available_for_write() { return tx_size - static_cast<uint8_t>(tx_head - tx_tail); }
+
+  void write(uint8_t b)
+  {
+    /* idle transmitter, skip the ring */
+    if (tx_head == tx_tail && (UCSR0A & (1 << UDRE0)))
+    {
+      noInterrupts();
+      UDR0 = b;
+      UCSR0A = (UCSR0A & (1 << U2X0)) | (1 << TXC0);
+      interrupts();
+      return;
+    }
+    uint8_t head = tx_head;
+    while (static_cast<uint8_t>(head - tx_tail) == tx_size)
+      _NOP();
+    tx_storage[head % tx_size] = b;
+    tx_head = head + 1;
+    /* UCSR0B is shared with the interrupt, which may clear UDRIE0 */
+    noInterrupts();
+    UCSR0B = UCSR0B | (1 << UDRIE0);
+    interrupts();
+  }
+
+  void write(const uint8_t *data, size_t size)
+  {
+    for (size_t i = 0; i < size; ++i)
+      write(data[i]);
+  }
+}
+
+ISR(USART_RX_vect)
+{
+  uart::receive();
+}
+
+ISR(USART_UDRE_vect)
+{
+  uart::transmit();
+}
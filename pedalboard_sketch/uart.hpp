@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Interrupt driven USART0, in place of the Arduino core Serial.
+ *
+ * The RX interrupt stores bytes in a ring the parser reads in place.
+ *  Transmission is fed from a second ring by the data register empty
+ *  interrupt. Each ring has a single producer and a single consumer and
+ *  8 bits indices, so neither side needs to mask interrupts.
+ */
+namespace uart
+{
+  /** Rings sizes, powers of 2 up to 128 **/
+  static constexpr const uint8_t rx_size = 128;
+  static constexpr const uint8_t tx_size = 64;
+
+  /** Contiguous received bytes **/
+  struct span
+  {
+    const uint8_t *data;
+    uint8_t size;
+  };
+
+  /** (Re)configure the link as 8N1, rings are kept **/
+  void begin(uint32_t baudrate);
+  /** Wait until every queued byte is on the wire **/
+  void flush();
+
+  /** Receive side **/
+
+  /** Oldest contiguous run of received bytes, empty when none **/
+  span readable();
+  /** Release the first n bytes of readable() **/
+  void consume(uint8_t n);
+  /** Bytes lost because the ring was full **/
+  uint16_t overruns();
+
+  /** Transmit side **/
+
+  /** Bytes write() takes without waiting **/
+  uint8_t available_for_write();
+  /** Queue bytes, waits for room when the ring is full **/
+  void write(uint8_t b);
+  void write(const uint8_t *data, size_t size);
+}
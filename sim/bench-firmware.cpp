@@ -0,0 +1,255 @@
+/**
+ * Firmware hot loop benchmark, on the mock HAL.
+ *
+ * The sketch is compiled for the host and its loop() stages are timed one
+ *  by one under scripted scenarios, in host cycles : they track the cost
+ *  of the code itself.
+ *
+ * Code execution is not modelled on the virtual clock, a fixed overhead
+ *  per iteration stands for it. Virtual time only paces the scenarios and
+ *  the UART, latencies on the wire are measured against it.
+ *
+ * usage : bench-firmware [iterations]
+ */
+#include "hal.hpp"
+#include "pedalboard_sketch.ino"
+
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static uint64_t ticks() { return __rdtsc(); }
+static const char *ticks_unit = "cycles";
+#else
+static uint64_t ticks()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+static const char *ticks_unit = "ns";
+#endif
+
+namespace
+{
+  /** Virtual time of one loop iteration **/
+  static constexpr const uint64_t loop_overhead_ns = 20000;
+
+  struct stage
+  {
+    stage(const char *name, void (*fn)()) : name(name), fn(fn) {}
+
+    const char *name;
+    void (*fn)();
+    uint64_t host = 0;    /**< accumulated host ticks */
+
+    void operator()()
+    {
+      uint64_t t = ticks();
+      fn();
+      host += ticks() - t;
+    }
+  };
+
+  void run(const char *name, size_t iterations, void (*script)(), void (*report)() = nullptr)
+  {
+    sim::reset();
+    datastore::configs = datastore::config();
+    setup();
+    uart::flush();
+    sim::clear_output();
+    script();
+
+    /* stages of loop(), in order */
+    stage stages[] = {
+        {"begin_frame", []()
+         { datastore::globals.begin_frame(); }},
+        {"process_serial_in", []()
+         { io::process_serial_in(); }},
+        {"read_inputs", []()
+         { datastore::globals.read_inputs(); }},
+        {"push_changes", []()
+         { datastore::globals.push_changes(io::out, uart::available_for_write()); }},
+        {"send", []()
+         { io::out.send(); }},
+    };
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i)
+    {
+      for (auto &s : stages)
+        s();
+      sim::advance(loop_overhead_ns);
+    }
+    double host = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    printf("%s\n", name);
+    printf("  host : %.0f loops/s, %zu bytes out, %lu bytes dropped in\n",
+           iterations / host, sim::board_output().size(),
+           static_cast<unsigned long>(sim::rx_dropped()));
+    for (const auto &s : stages)
+      printf("    %-18s %10.1f %s\n", s.name,
+             double(s.host) / iterations, ticks_unit);
+    if (report)
+      report();
+  }
+
+  /** Scenarios **/
+
+  void idle() {}
+
+  /** Times footswitch 0 changed level, in ns **/
+  std::vector<uint64_t> toggles;
+
+  /** Footswitch 0 toggles every 20ms, first after delay ns **/
+  void toggle_switch(uint64_t delay)
+  {
+    toggles.clear();
+    static int level = HIGH;
+    static std::function<void()> toggle = []()
+    {
+      level = level == HIGH ? LOW : HIGH;
+      sim::set_digital(harddefs::switch_pin(0), level);
+      toggles.push_back(sim::now());
+      sim::at(sim::now() + 20000000, toggle);
+    };
+    level = HIGH; /* as set by the pull up */
+    sim::at(sim::now() + delay, toggle);
+  }
+
+  void switches() { toggle_switch(0); }
+
+  /** Both pedals enabled by the host and swept back and forth **/
+  void sweep()
+  {
+    for (uint8_t i = 0; i < harddefs::exprs_count; ++i)
+    {
+      const uint8_t enable[] = {uint8_t(0xC0 | i), datastore::configs.expression_cc, datastore::expr::state::Enabled};
+      sim::host_send(enable);
+    }
+    static int value = 0;
+    static std::function<void()> step = []()
+    {
+      value = (value + 1) % 2048;
+      int v = value < 1024 ? value : 2047 - value;
+      for (uint8_t i = 0; i < harddefs::exprs_count; ++i)
+        sim::set_analog(harddefs::expr_pin(i), v);
+      sim::at(sim::now() + 1000000, step);
+    };
+    sim::at(sim::now(), step);
+  }
+
+  /** Both pedals enabled and resting, with +/-2 LSB of ADC noise **/
+  void noisy()
+  {
+    for (uint8_t i = 0; i < harddefs::exprs_count; ++i)
+    {
+      const uint8_t enable[] = {uint8_t(0xC0 | i), datastore::configs.expression_cc, datastore::expr::state::Enabled};
+      sim::host_send(enable);
+      sim::set_analog(harddefs::expr_pin(i), 512);
+      sim::set_analog_noise(harddefs::expr_pin(i), 2);
+    }
+  }
+
+  /** Pedals swept fast, unthrottled and with event records, while
+   *  footswitch 0 toggles every 20ms **/
+  void contended()
+  {
+    datastore::configs.expression_period_ms = 0;
+    datastore::configs.debug = true;
+    for (uint8_t i = 0; i < harddefs::exprs_count; ++i)
+    {
+      const uint8_t enable[] = {uint8_t(0xC0 | i), datastore::configs.expression_cc, datastore::expr::state::Enabled};
+      sim::host_send(enable);
+    }
+    static int value = 0;
+    static std::function<void()> step = []()
+    {
+      value = (value + 4) % 2048;
+      int v = value < 1024 ? value : 2047 - value;
+      for (uint8_t i = 0; i < harddefs::exprs_count; ++i)
+        sim::set_analog(harddefs::expr_pin(i), v);
+      sim::at(sim::now() + 1000000, step);
+    };
+    sim::at(sim::now(), step);
+    toggle_switch(7300000);
+  }
+
+  /** Delay between a switch toggle and its CC leaving the wire **/
+  void switch_latency()
+  {
+    const auto &out = sim::board_output();
+    const auto &times = sim::board_output_times();
+    std::vector<uint64_t> latencies;
+    for (size_t i = 0; i + 2 < out.size(); ++i)
+    {
+      if (out[i] == sysex::start)
+      {
+        while (i < out.size() && out[i] != sysex::end)
+          ++i;
+        continue;
+      }
+      if (out[i] != 0xC0 || out[i + 1] != datastore::configs.footswitch_cc)
+        continue;
+      size_t n = latencies.size();
+      if (n < toggles.size())
+        latencies.push_back(times[i + 2] - toggles[n]);
+      i += 2;
+    }
+    if (latencies.empty())
+      return;
+    std::sort(latencies.begin(), latencies.end());
+    printf("  switch latency : %zu events, p50 %.0f us, max %.0f us\n", latencies.size(),
+           latencies[latencies.size() / 2] * 1e-3, latencies.back() * 1e-3);
+  }
+
+  /** Host sets a LED every 50ms **/
+  void leds()
+  {
+    static uint8_t n = 0;
+    static std::function<void()> step = []()
+    {
+      n += 1;
+      const uint8_t msg[] = {uint8_t(0xC0 | (n % harddefs::channels_count)), datastore::configs.led_cc, uint8_t(n / harddefs::channels_count % 2)};
+      sim::host_send(msg);
+      sim::at(sim::now() + 50000000, step);
+    };
+    sim::at(sim::now(), step);
+  }
+
+  /** Host sets every LED at once every 50ms, a few of them blinking **/
+  void led_frames()
+  {
+    static uint8_t n = 0;
+    static std::function<void()> step = []()
+    {
+      n += 1;
+      uint8_t on = n, blink = n >> 4;
+      const uint8_t msg[] = {sysex::start, sysex::manufacturer[0], sysex::manufacturer[1], sysex::Leds,
+                             uint8_t(on & 0x7F), uint8_t(on >> 7), uint8_t(blink & 0x7F), uint8_t(blink >> 7),
+                             sysex::end};
+      sim::host_send(msg);
+      sim::at(sim::now() + 50000000, step);
+    };
+    sim::at(sim::now(), step);
+  }
+}
+
+int main(int argc, char *const argv[])
+{
+  size_t iterations = 1 < argc ? std::atol(argv[1]) : 20000;
+
+  run("idle", iterations, idle);
+  run("switches", iterations, switches, switch_latency);
+  run("expression sweep", iterations, sweep);
+  run("noisy pedals", iterations, noisy);
+  run("switches during sweep", iterations, contended, switch_latency);
+  run("host leds", iterations, leds);
+  run("host led frames", iterations, led_frames);
+  return 0;
+}
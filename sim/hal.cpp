@@ -0,0 +1,430 @@
+#include "hal.hpp"
+
+#include <Arduino.h>
+#include <EEPROM.h>
+
+#include <map>
+#include <deque>
+#include <random>
+#include <algorithm>
+
+EEPROMClass EEPROM;
+
+sim_port PORTB(0, sim_port::Data), PORTC(1, sim_port::Data), PORTD(2, sim_port::Data);
+sim_port DDRB(0, sim_port::Direction), DDRC(1, sim_port::Direction), DDRD(2, sim_port::Direction);
+volatile uint8_t TCCR1A, TCCR1B, TIMSK1;
+volatile uint16_t OCR1A;
+volatile uint8_t TCCR2A, TCCR2B, OCR2A, TIMSK2;
+volatile uint8_t ADMUX, ADCSRA;
+volatile uint16_t ADC;
+sim_udr0 UDR0;
+sim_ucsr0a UCSR0A;
+volatile uint8_t UCSR0B, UCSR0C;
+volatile uint16_t UBRR0;
+
+/* sketches without interrupt handlers */
+extern "C" __attribute__((weak)) void sim_timer1_compa_vect() {}
+extern "C" __attribute__((weak)) void sim_timer2_compa_vect() {}
+extern "C" __attribute__((weak)) void sim_adc_vect() {}
+extern "C" __attribute__((weak)) void sim_usart_rx_vect() {}
+extern "C" __attribute__((weak)) void sim_usart_udre_vect() {}
+
+namespace
+{
+  static constexpr const int pins_count = 22;
+
+  struct pin
+  {
+    int mode = INPUT;
+    int input = LOW;   /**< level seen by digitalRead */
+    int analog = 0;    /**< value seen by analogRead */
+    int noise = 0;     /**< amplitude of conversion noise */
+    int output = LOW;  /**< level set by digitalWrite */
+  };
+
+  struct state
+  {
+    sim::costs costs;
+    uint64_t clock = 0;
+    pin pins[pins_count];
+    std::multimap<uint64_t, std::function<void()>> schedule;
+
+    /* USART0 */
+    bool u2x = false;
+    std::deque<uint8_t> wire_in;  /**< host bytes not received yet */
+    uint64_t rx_at = 0;           /**< arrival of wire_in.front(), 0 when idle */
+    bool rxc = false;             /**< rx_data not read yet */
+    uint8_t rx_data = 0;
+    int tx_data = -1;             /**< data register, -1 when empty */
+    int tx_shift = -1;            /**< byte on the wire, -1 when idle */
+    uint64_t tx_at = 0;           /**< end of tx_shift */
+    bool txc = false;
+    std::vector<uint8_t> tx;
+    std::vector<uint64_t> tx_times;
+    uint64_t blocked = 0;
+    uint64_t dropped = 0;
+
+    uint64_t timer1_at = 0;   /**< next compare match, 0 while stopped */
+    uint64_t timer2_at = 0;
+    uint64_t adc_at = 0;      /**< end of the running conversion, 0 when idle */
+    std::minstd_rand rng;
+  };
+
+  state hal;
+
+  unsigned long baudrate()
+  {
+    if (!(UCSR0B & ((1 << RXEN0) | (1 << TXEN0))))
+      return 0;
+    return F_CPU / (hal.u2x ? 8 : 16) / (UBRR0 + 1);
+  }
+
+  /** Time to shift one byte, 8N1 **/
+  uint64_t byte_time()
+  {
+    return 10000000000ULL / baudrate();
+  }
+
+  /** Arrival of the next host byte, UINT64_MAX when none **/
+  uint64_t rx_next()
+  {
+    if (hal.wire_in.empty())
+      return UINT64_MAX;
+    if (baudrate() == 0 || !(UCSR0B & (1 << RXEN0)))
+    {
+      /* nobody listening */
+      hal.dropped += hal.wire_in.size();
+      hal.wire_in.clear();
+      hal.rx_at = 0;
+      return UINT64_MAX;
+    }
+    if (hal.rx_at == 0)
+      hal.rx_at = hal.clock + byte_time();
+    return hal.rx_at;
+  }
+
+  void receive()
+  {
+    uint8_t b = hal.wire_in.front();
+    hal.wire_in.pop_front();
+    hal.rx_at = hal.wire_in.empty() ? 0 : hal.rx_at + byte_time();
+    /* data overrun, the previous byte was not read in time */
+    if (hal.rxc)
+    {
+      hal.dropped += 1;
+      return;
+    }
+    hal.rx_data = b;
+    hal.rxc = true;
+    if (UCSR0B & (1 << RXCIE0))
+      sim_usart_rx_vect();
+  }
+
+  /** End of the byte on the wire, UINT64_MAX when idle **/
+  uint64_t tx_next() { return hal.tx_shift < 0 ? UINT64_MAX : hal.tx_at; }
+
+  void transmitted()
+  {
+    hal.tx.push_back(static_cast<uint8_t>(hal.tx_shift));
+    hal.tx_times.push_back(hal.tx_at);
+    hal.tx_shift = hal.tx_data;
+    hal.tx_data = -1;
+    if (hal.tx_shift < 0)
+      hal.txc = true;
+    else
+      hal.tx_at += byte_time();
+  }
+
+  /** Data register empty interrupt is level triggered **/
+  bool udre_pending()
+  {
+    return (UCSR0B & (1 << UDRIE0)) && (UCSR0B & (1 << TXEN0)) && hal.tx_data < 0;
+  }
+
+  /** Compare match period in CTC mode, 0 when it raises no interrupt **/
+  uint64_t timer1_period()
+  {
+    /* external clock sources are not modelled */
+    static const uint16_t prescalers[] = {0, 1, 8, 64, 256, 1024, 0, 0};
+    uint16_t prescaler = prescalers[TCCR1B & 0x07];
+    if (prescaler == 0 || !(TIMSK1 & (1 << OCIE1A)))
+      return 0;
+    return uint64_t(OCR1A + 1) * prescaler * 1000000000ULL / F_CPU;
+  }
+  uint64_t timer2_period()
+  {
+    static const uint16_t prescalers[] = {0, 1, 8, 32, 64, 128, 256, 1024};
+    uint16_t prescaler = prescalers[TCCR2B & 0x07];
+    if (prescaler == 0 || !(TIMSK2 & (1 << OCIE2A)))
+      return 0;
+    return uint64_t(OCR2A + 1) * prescaler * 1000000000ULL / F_CPU;
+  }
+
+  /** Next compare match of a timer, UINT64_MAX while it is stopped **/
+  uint64_t timer_next(uint64_t period, uint64_t &at)
+  {
+    if (period == 0)
+      at = 0;
+    else if (at == 0)
+      at = hal.clock + period;
+    return period == 0 ? UINT64_MAX : at;
+  }
+
+  /** End of the conversion started with ADSC, UINT64_MAX when none **/
+  uint64_t adc_next()
+  {
+    if (!(ADCSRA & (1 << ADEN)) || !(ADCSRA & (1 << ADSC)))
+    {
+      hal.adc_at = 0;
+      return UINT64_MAX;
+    }
+    if (hal.adc_at == 0)
+    {
+      /* 13 ADC clocks per conversion */
+      uint8_t prescaler = 1 << std::max(1, ADCSRA & 0x07);
+      hal.adc_at = hal.clock + 13ULL * prescaler * 1000000000ULL / F_CPU;
+    }
+    return hal.adc_at;
+  }
+
+  int convert(uint8_t p)
+  {
+    int value = hal.pins[p].analog;
+    if (hal.pins[p].noise != 0)
+      value += std::uniform_int_distribution<>(-hal.pins[p].noise, hal.pins[p].noise)(hal.rng);
+    return std::min(1023, std::max(0, value));
+  }
+
+  void block(uint64_t ns)
+  {
+    hal.blocked += ns;
+    sim::advance(ns);
+  }
+}
+
+namespace sim
+{
+  void reset(const costs &c)
+  {
+    hal = state();
+    hal.costs = c;
+    TCCR1A = 0;
+    TCCR1B = 0;
+    OCR1A = 0;
+    TIMSK1 = 0;
+    TCCR2A = 0;
+    TCCR2B = 0;
+    OCR2A = 0;
+    TIMSK2 = 0;
+    ADMUX = 0;
+    ADCSRA = 0;
+    ADC = 0;
+    UCSR0B = 0;
+    UCSR0C = 0;
+    UBRR0 = 0;
+  }
+
+  uint64_t now() { return hal.clock; }
+
+  void advance(uint64_t ns)
+  {
+    uint64_t target = hal.clock + ns;
+    for (;;)
+    {
+      /* interrupts and scripted actions, in time order */
+      if (udre_pending())
+      {
+        sim_usart_udre_vect();
+        continue;
+      }
+      uint64_t blink = timer_next(timer1_period(), hal.timer1_at);
+      uint64_t tick = timer_next(timer2_period(), hal.timer2_at);
+      uint64_t conversion = adc_next();
+      uint64_t rx = rx_next();
+      uint64_t tx = tx_next();
+      uint64_t action = hal.schedule.empty() ? UINT64_MAX : hal.schedule.begin()->first;
+      uint64_t next = std::min({blink, tick, conversion, rx, tx, action});
+      if (target < next)
+        break;
+
+      if (next == tx)
+      {
+        hal.clock = std::max(hal.clock, tx);
+        transmitted();
+      }
+      else if (next == rx)
+      {
+        hal.clock = std::max(hal.clock, rx);
+        receive();
+      }
+      else if (next == tick)
+      {
+        hal.clock = std::max(hal.clock, tick);
+        hal.timer2_at += timer2_period();
+        sim_timer2_compa_vect();
+      }
+      else if (next == blink)
+      {
+        hal.clock = std::max(hal.clock, blink);
+        hal.timer1_at += timer1_period();
+        sim_timer1_compa_vect();
+      }
+      else if (next == conversion)
+      {
+        hal.clock = std::max(hal.clock, conversion);
+        hal.adc_at = 0;
+        ADC = convert(A0 + (ADMUX & 0x07));
+        ADCSRA = ADCSRA & ~(1 << ADSC);
+        if (ADCSRA & (1 << ADIE))
+          sim_adc_vect();
+      }
+      else
+      {
+        auto node = hal.schedule.extract(hal.schedule.begin());
+        hal.clock = std::max(hal.clock, node.key());
+        node.mapped()();
+      }
+    }
+    hal.clock = std::max(hal.clock, target);
+  }
+
+  void at(uint64_t t, std::function<void()> action)
+  {
+    hal.schedule.emplace(t, std::move(action));
+  }
+
+  void set_digital(uint8_t p, int level) { hal.pins[p].input = level; }
+  void set_analog(uint8_t p, int value) { hal.pins[p].analog = value; }
+  void set_analog_noise(uint8_t p, int amplitude) { hal.pins[p].noise = amplitude; }
+
+  int pin_mode(uint8_t p) { return hal.pins[p].mode; }
+  int digital_output(uint8_t p) { return hal.pins[p].output; }
+
+  unsigned long baudrate() { return ::baudrate(); }
+  void host_send(const uint8_t *bytes, size_t size)
+  {
+    hal.wire_in.insert(hal.wire_in.end(), bytes, bytes + size);
+  }
+  uint64_t rx_dropped() { return hal.dropped; }
+  std::vector<uint8_t> &board_output() { return hal.tx; }
+  const std::vector<uint64_t> &board_output_times() { return hal.tx_times; }
+  void clear_output()
+  {
+    hal.tx.clear();
+    hal.tx_times.clear();
+  }
+  uint64_t blocked() { return hal.blocked; }
+}
+
+/** Ports **/
+
+namespace
+{
+  /* B : pins 8-13, C : A0-A5, D : 0-7 */
+  static const uint8_t port_first[] = {8, 14, 0};
+  static const uint8_t port_count[] = {6, 6, 8};
+}
+
+uint8_t sim_read_port(uint8_t port)
+{
+  uint8_t value = 0;
+  for (uint8_t i = 0; i < port_count[port]; ++i)
+    if (hal.pins[port_first[port] + i].input == HIGH)
+      value |= 1 << i;
+  return value;
+}
+
+sim_port::operator uint8_t() const
+{
+  uint8_t value = 0;
+  for (uint8_t i = 0; i < port_count[_port]; ++i)
+  {
+    const pin &p = hal.pins[port_first[_port] + i];
+    if (_kind == Data ? p.output == HIGH : p.mode == OUTPUT)
+      value |= 1 << i;
+  }
+  return value;
+}
+sim_port &sim_port::operator=(uint8_t v)
+{
+  for (uint8_t i = 0; i < port_count[_port]; ++i)
+  {
+    pin &p = hal.pins[port_first[_port] + i];
+    bool set = v & (1 << i);
+    if (_kind == Data)
+      p.output = set ? HIGH : LOW;
+    else if (set)
+      p.mode = OUTPUT;
+    else if (p.mode == OUTPUT)
+      p.mode = INPUT;
+  }
+  return *this;
+}
+
+/** Arduino core **/
+
+void pinMode(uint8_t p, uint8_t mode)
+{
+  hal.pins[p].mode = mode;
+  /* pull up reads high until something drives the pin */
+  if (mode == INPUT_PULLUP)
+    hal.pins[p].input = HIGH;
+}
+int digitalRead(uint8_t p)
+{
+  block(hal.costs.digital_io_ns);
+  return hal.pins[p].input;
+}
+void digitalWrite(uint8_t p, uint8_t val)
+{
+  block(hal.costs.digital_io_ns);
+  hal.pins[p].output = val;
+}
+int analogRead(uint8_t p)
+{
+  block(hal.costs.analog_read_ns);
+  return convert(p);
+}
+
+/* 32 bits counters wrap like on AVR */
+unsigned long millis() { return static_cast<uint32_t>(hal.clock / 1000000); }
+unsigned long micros() { return static_cast<uint32_t>(hal.clock / 1000); }
+void delay(unsigned long ms) { block(ms * 1000000); }
+void delayMicroseconds(unsigned int us) { block(us * 1000); }
+
+void sim_nop() { block(1000000000ULL / F_CPU); }
+
+/** USART0 **/
+
+sim_udr0::operator uint8_t() const
+{
+  hal.rxc = false;
+  return hal.rx_data;
+}
+sim_udr0 &sim_udr0::operator=(uint8_t b)
+{
+  if (!(UCSR0B & (1 << TXEN0)))
+    return *this;
+  if (hal.tx_shift < 0)
+  {
+    hal.tx_shift = b;
+    hal.tx_at = hal.clock + byte_time();
+  }
+  else if (hal.tx_data < 0)
+  {
+    hal.tx_data = b;
+  }
+  return *this;
+}
+
+sim_ucsr0a::operator uint8_t() const
+{
+  return (hal.rxc << RXC0) | (hal.txc << TXC0) | ((hal.tx_data < 0) << UDRE0) | (hal.u2x << U2X0);
+}
+sim_ucsr0a &sim_ucsr0a::operator=(uint8_t v)
+{
+  if (v & (1 << TXC0))
+    hal.txc = false;
+  hal.u2x = v & (1 << U2X0);
+  return *this;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+/**
+ * Scripting side of the mock Arduino HAL.
+ *
+ * Time is virtual : it only moves through advance() or when the sketch
+ *  calls something that blocks on hardware (analogRead, delay, busy
+ *  waits with _NOP). Actions scheduled with at() and enabled interrupts
+ *  run as soon as the clock reaches them.
+ *
+ * USART0 is modelled at the register level : host bytes arrive one byte
+ *  time apart, board bytes leave through the data and shift registers.
+ */
+
+#include <stddef.h>
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+namespace sim
+{
+  /** Hardware timings of an ATmega328 at 16MHz **/
+  struct costs
+  {
+    uint32_t analog_read_ns = 112000; /**< blocking conversion */
+    uint32_t digital_io_ns = 3500;    /**< digitalRead / digitalWrite */
+  };
+
+  /** Reset pins, clock, UART and schedule **/
+  void reset(const costs &c = costs());
+
+  /** Virtual clock, in nanoseconds **/
+  uint64_t now();
+  void advance(uint64_t ns);
+  /** Run action once the clock reaches t **/
+  void at(uint64_t t, std::function<void()> action);
+
+  /** Inputs **/
+  void set_digital(uint8_t pin, int level);
+  void set_analog(uint8_t pin, int value);
+  /** Uniform noise of +/- amplitude added to each conversion of pin **/
+  void set_analog_noise(uint8_t pin, int amplitude);
+
+  /** Outputs **/
+  int pin_mode(uint8_t pin);
+  int digital_output(uint8_t pin);
+
+  /** UART, host side **/
+  unsigned long baudrate();
+  /** Bytes sent by the host, received at the link rate **/
+  void host_send(const uint8_t *bytes, size_t size);
+  template <size_t N>
+  void host_send(const uint8_t (&bytes)[N]) { host_send(bytes, N); }
+  /** Host bytes lost by the USART since reset : overruns, receiver off **/
+  uint64_t rx_dropped();
+  /** Bytes written by the sketch **/
+  std::vector<uint8_t> &board_output();
+  /** Time each byte of board_output is fully shifted out, in ns **/
+  const std::vector<uint64_t> &board_output_times();
+  void clear_output();
+  /** Virtual time spent blocked on hardware since reset, in ns **/
+  uint64_t blocked();
+}
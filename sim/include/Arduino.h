@@ -0,0 +1,139 @@
+#pragma once
+
+/**
+ * Host mock of the Arduino core and ATmega328 registers, just what the
+ *  pedalboard sketch uses. Pins, clock and peripherals are simulated by
+ *  sim/hal.cpp, see sim/hal.hpp to script inputs and inspect outputs.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define DEC 10
+#define HEX 16
+
+/** ATmega328 (Nano) analog pins **/
+static constexpr const uint8_t A0 = 14;
+static constexpr const uint8_t A1 = 15;
+static constexpr const uint8_t A2 = 16;
+static constexpr const uint8_t A3 = 17;
+static constexpr const uint8_t A4 = 18;
+static constexpr const uint8_t A5 = 19;
+static constexpr const uint8_t A6 = 20;
+static constexpr const uint8_t A7 = 21;
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+/** AVR registers the sketch touches, emulated by sim/hal.cpp **/
+uint8_t sim_read_port(uint8_t port);
+#define PINB sim_read_port(0)
+#define PINC sim_read_port(1)
+#define PIND sim_read_port(2)
+
+/* output latches and directions, mapped on the pins of sim/hal.cpp */
+class sim_port
+{
+public:
+  enum kind : uint8_t
+  {
+    Data,
+    Direction,
+  };
+  sim_port(uint8_t port, kind k) : _port(port), _kind(k) {}
+
+  operator uint8_t() const;
+  sim_port &operator=(uint8_t v);
+  sim_port &operator|=(uint8_t v) { return *this = *this | v; }
+  sim_port &operator&=(uint8_t v) { return *this = *this & v; }
+
+private:
+  uint8_t _port;
+  kind _kind;
+};
+extern sim_port PORTB, PORTC, PORTD, DDRB, DDRC, DDRD;
+
+extern volatile uint8_t TCCR1A, TCCR1B, TIMSK1;
+extern volatile uint16_t OCR1A;
+#define WGM12 3
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define OCIE1A 1
+
+extern volatile uint8_t TCCR2A, TCCR2B, OCR2A, TIMSK2;
+#define WGM20 0
+#define WGM21 1
+#define CS20 0
+#define CS21 1
+#define CS22 2
+#define OCIE2A 1
+
+extern volatile uint8_t ADMUX, ADCSRA;
+extern volatile uint16_t ADC;
+#define REFS0 6
+#define ADEN 7
+#define ADSC 6
+#define ADIE 3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+
+/* USART0, data and status registers have side effects on access */
+class sim_udr0
+{
+public:
+  operator uint8_t() const;            /**< pops the received byte */
+  sim_udr0 &operator=(uint8_t b);      /**< starts a transmission */
+};
+class sim_ucsr0a
+{
+public:
+  operator uint8_t() const;
+  sim_ucsr0a &operator=(uint8_t v);    /**< writing TXC0 clears it */
+};
+extern sim_udr0 UDR0;
+extern sim_ucsr0a UCSR0A;
+extern volatile uint8_t UCSR0B, UCSR0C;
+extern volatile uint16_t UBRR0;
+#define RXC0 7
+#define TXC0 6
+#define UDRE0 5
+#define U2X0 1
+#define RXCIE0 7
+#define UDRIE0 5
+#define RXEN0 4
+#define TXEN0 3
+#define UCSZ01 2
+#define UCSZ00 1
+
+/* interrupt handlers only run while the virtual clock moves */
+#define ISR(vector) extern "C" void vector()
+#define TIMER1_COMPA_vect sim_timer1_compa_vect
+#define TIMER2_COMPA_vect sim_timer2_compa_vect
+#define ADC_vect sim_adc_vect
+#define USART_RX_vect sim_usart_rx_vect
+#define USART_UDRE_vect sim_usart_udre_vect
+#define noInterrupts()
+#define interrupts()
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t val);
+int analogRead(uint8_t pin);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
@@ -0,0 +1,38 @@
+#pragma once
+
+/** Host mock of the Arduino EEPROM library, backed by RAM **/
+
+#include <stdint.h>
+#include <string.h>
+
+class EEPROMClass
+{
+public:
+  static constexpr const int size = 1024;
+
+  EEPROMClass() { memset(storage, 0xFF, size); } /**< erased state */
+
+  uint8_t read(int idx) const { return storage[idx]; }
+  void write(int idx, uint8_t val) { storage[idx] = val; }
+  void update(int idx, uint8_t val) { storage[idx] = val; }
+
+  template <typename T>
+  T &get(int idx, T &t) const
+  {
+    memcpy(&t, storage + idx, sizeof(T));
+    return t;
+  }
+  template <typename T>
+  const T &put(int idx, const T &t)
+  {
+    memcpy(storage + idx, &t, sizeof(T));
+    return t;
+  }
+
+  int length() const { return size; }
+
+private:
+  uint8_t storage[size];
+};
+
+extern EEPROMClass EEPROM;
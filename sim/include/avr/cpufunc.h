@@ -0,0 +1,6 @@
+#pragma once
+
+/** Host mock of avr-libc cpufunc.h, a nop burns one cpu cycle of virtual time **/
+
+void sim_nop();
+#define _NOP() sim_nop()
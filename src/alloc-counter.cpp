@@ -0,0 +1,33 @@
+#include "alloc-counter.hpp"
+
+#include <new>
+#include <atomic>
+#include <cstdlib>
+
+namespace {
+  std::atomic<std::size_t> allocations{0};
+  std::atomic<std::size_t> allocated{0};
+
+  void* counted_alloc(std::size_t size)
+  {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocated.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size))
+      return p;
+    throw std::bad_alloc();
+  }
+}
+
+namespace sfx {
+  namespace alloc {
+    std::size_t count() { return allocations.load(std::memory_order_relaxed); }
+    std::size_t bytes() { return allocated.load(std::memory_order_relaxed); }
+  }
+}
+
+void* operator new(std::size_t size) { return counted_alloc(size); }
+void* operator new[](std::size_t size) { return counted_alloc(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
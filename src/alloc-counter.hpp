@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+
+namespace sfx {
+  namespace alloc {
+
+    /**
+     * Global operator new hook counting heap allocations.
+     * Only available to targets linking alloc-counter.cpp, which replaces
+     *  the global allocation functions.
+     */
+
+    /** Count of allocations since program start **/
+    std::size_t count();
+    /** Count of bytes requested since program start **/
+    std::size_t bytes();
+  }
+}
@@ -1,5 +1,16 @@
 #include "serial-io.hpp"
 #include "parser.hpp"
+#include "reactor.hpp"
+#include "midi.hpp"
+#include "timing.hpp"
+#include "state.hpp"
+#include "snapshot.hpp"
+#include "pipeline.hpp"
+#include "device.hpp"
+#include "realtime.hpp"
+#include "capture.hpp"
+#include "metrics.hpp"
+#include "alloc-counter.hpp"
 #include <termios.h>
 #include <iostream>
 #include <cstddef>
@@ -8,36 +19,303 @@
 #include <string>
 #include <sstream>
 #include <algorithm>
+#include <chrono>
+#include <utility>
+#include <cstdlib>
+#include <span>
 
 #include <unistd.h>
 #include <error.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
 
 // #define __ENABLE_TESTING__
 
 void usage()
 {
-    std::cout << "5FX-Pedalboard port baudrate" << std::endl;
+    std::cout << "5FX-Pedalboard port baudrate [--debug] [--realtime [--cpu n]]"
+                 " [--vmin bytes] [--vtime ds] [--coalesce us] [--no-reset] [--wait ms]"
+                 " [--capture file] [--metrics socket]" << std::endl;
+    std::cout << "5FX-Pedalboard --rig file [--debug] [--realtime [--cpu n]] [--no-reset]"
+                 " [--metrics socket]" << std::endl;
+}
+
+struct options {
+    bool debug = false;
+    bool realtime = false;            /**< Lock, pin and prioritize the I/O thread */
+    sfx::io::realtime::config rt;
+    sfx::io::serial::config link;     /**< Receive policy and hang up only, see serial::config */
+    std::chrono::milliseconds wait{5000}; /**< Longest wait for the board presentation */
+    std::string capture;              /**< Log of the received traffic, see io::capture */
+    std::string metrics;              /**< Unix socket serving io::metrics snapshots */
+};
+
+/** Flags following the port and baudrate, or the rig file **/
+bool parse_options(int argc, char *const argv[], options& opts)
+{
+    if (argc < 3)
+        return false;
+    for (int i = 3; i < argc; ++i)
+    {
+        std::string opt = argv[i];
+        if (opt == "--debug")
+            opts.debug = true;
+        else if (opt == "--realtime")
+            opts.realtime = true;
+        else if (opt == "--cpu" && i + 1 < argc)
+            opts.rt.cpu = std::atoi(argv[++i]);
+        else if (opt == "--vmin" && i + 1 < argc)
+            opts.link.vmin = uint8_t(std::atoi(argv[++i]));
+        else if (opt == "--vtime" && i + 1 < argc)
+            opts.link.vtime = uint8_t(std::atoi(argv[++i]));
+        else if (opt == "--coalesce" && i + 1 < argc)
+            opts.link.coalesce = std::chrono::microseconds(std::atol(argv[++i]));
+        else if (opt == "--no-reset")
+            opts.link.hangup = false;
+        else if (opt == "--wait" && i + 1 < argc)
+            opts.wait = std::chrono::milliseconds(std::atol(argv[++i]));
+        else if (opt == "--capture" && i + 1 < argc)
+            opts.capture = argv[++i];
+        else if (opt == "--metrics" && i + 1 < argc)
+            opts.metrics = argv[++i];
+        else
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Heap allocations of the running bridge, checked once warmed up : in
+ *  realtime mode the steady state must not allocate. Counts every thread,
+ *  work known to allocate outside the hot path is run through exempt().
+ */
+class alloc_check {
+public:
+    static constexpr unsigned warmup_ticks = 5;
+
+    /** Call once per period, returns allocations since the former call **/
+    std::size_t tick()
+    {
+        std::size_t n = sfx::alloc::count();
+        std::size_t since = n - std::exchange(_last, n);
+        return warmup_ticks < ++_ticks ? since : 0;
+    }
+    template <typename Fn> void exempt(Fn&& fn)
+    {
+        std::size_t before = sfx::alloc::count();
+        fn();
+        _last += sfx::alloc::count() - before;
+    }
+
+private:
+    unsigned    _ticks = 0;
+    std::size_t _last = 0;
+};
+
+/** Enter realtime mode if requested, and watch for allocations once warm **/
+void setup_realtime(sfx::io::reactor& loop, const options& opts, alloc_check& allocs)
+{
+    using namespace sfx;
+    if (!opts.realtime)
+        return;
+    auto r = io::realtime::enter(opts.rt);
+    std::cerr << "Realtime : " << r.str() << std::endl;
+    loop.every(std::chrono::seconds(1), [&allocs](uint64_t)
+    {
+        if (auto n = allocs.tick())
+            std::cerr << "Heap allocations on the hot path : " << n << " in the last second" << std::endl;
+    });
+}
+
+/** Serve metrics if requested, before realtime mode so the endpoint thread stays time shared **/
+bool setup_metrics(sfx::io::metrics::endpoint& endpoint, sfx::io::metrics::registry& registry, const options& opts)
+{
+    using namespace sfx;
+    if (opts.metrics.empty())
+        return true;
+    if (io::metrics::endpoint::result::Ok != endpoint.begin(registry, opts.metrics))
+    {
+        std::cerr << "Failed serve metrics on " << opts.metrics << std::endl;
+        perror("");
+        return false;
+    }
+    return true;
+}
+
+/** DEBUG : print messages received from the pedalboard, after from in a rig **/
+void dispatch(const sfx::midi::message& msg, const std::string& from = std::string())
+{
+    using namespace sfx;
+    /* pongs feed the clock sync and acks the link setup, both binary */
+    if (midi::is_command(msg, sysex::Ping) || midi::is_command(msg, sysex::Baudrate))
+        return;
+    if (!from.empty())
+        std::cout << from << " : ";
+    if (auto ev = midi::decode_event(msg))
+    {
+        std::cout << (ev->kind == sysex::Switch ? "SW changed : " : "Expr changed : ")
+                  << int(ev->id) << " : " << ev->value << '\n';
+    }
+    else if (midi::is_command(msg, sysex::Present) || midi::is_command(msg, sysex::Print))
+    {
+        std::cout << (midi::is_command(msg, sysex::Present) ? "Present " : "Print ");
+        for (auto c : midi::arguments(msg))
+            std::cout << char(c);
+        std::cout << '\n';
+    }
+    else if (msg.is_sysex())
+    {
+        std::cout << "Sysex ";
+        for (uint8_t i = 0; i < msg.size; ++i)
+            std::cout << char(msg.data[i]);
+        std::cout << '\n';
+    }
+    else
+    {
+        std::cout << "CC : " << int(msg.channel())
+                  << " : " << int(msg.data[0])
+                  << " : " << int(msg.data[1]) << '\n';
+    }
+}
+
+/** Every board listed in path, on one event loop **/
+int run_rig(const std::string& path, const options& opts)
+{
+    using namespace sfx;
+
+    if (!opts.capture.empty())
+    {
+        std::cerr << "Capture is not supported with a rig" << std::endl;
+        return -1;
+    }
+
+    io::metrics::registry registry;
+    io::reactor loop;
+    if (io::reactor::result::Ok != loop.begin())
+    {
+        std::cerr << "Failed create event loop" << std::endl;
+        perror("");
+        return -1;
+    }
+
+    io::metrics::endpoint endpoint;
+    if (!opts.metrics.empty())
+        loop.instrument(registry);
+
+    io::rig boards(loop);
+    io::device::config defaults;
+    defaults.link = opts.link;
+    if (auto [code, line] = boards.load(path, defaults); io::rig::result::Ok != code)
+    {
+        if (line == 0)
+            std::cerr << "Failed read " << path << std::endl;
+        else
+            std::cerr << path << ":" << line << " : expected port baudrate [name]" << std::endl;
+        return -1;
+    }
+
+    boards.on_message([](io::device& d, const midi::message& msg)
+    {
+        dispatch(msg, d.label());
+    });
+    boards.on_state([&](io::device& d)
+    {
+        switch (d.state())
+        {
+        case io::device::status::Closed:
+            if (d.refused())
+                std::cerr << "Refused " << d.label() << ", expected " << d.cfg().name << std::endl;
+            else
+                std::cerr << "Unplugged " << d.label() << std::endl;
+            break;
+        case io::device::status::Identifying:
+            std::cerr << "Plugged " << d.label() << std::endl;
+            break;
+        case io::device::status::Negotiating:
+            break;
+        case io::device::status::Ready:
+            std::cerr << "Ready " << d.label() << " at " << d.link().cfg().baudrate
+                      << " bauds after " << std::chrono::duration_cast<std::chrono::milliseconds>(
+                             io::device::clock_type::now() - d.opened()).count()
+                      << "ms, " << boards.ready() << "/" << boards.size() << std::endl;
+            /* keyed by name@port once identified, the handshake is not
+               counted ; figures of a board plugged again go on */
+            if (!opts.metrics.empty())
+                d.link().instrument(registry, "board." + d.label());
+            if (d.link().cfg().baudrate != d.cfg().baudrate)
+                std::cerr << d.label() << " did not switch to " << d.cfg().baudrate << " bauds" << std::endl;
+            if (opts.debug)
+                d.post(midi::command(sysex::Debug, {1}));
+            break;
+        }
+    });
+
+    /** Everything queued during a round goes out in a single write per board **/
+    loop.after_dispatch([&]() { boards.transmit(); });
+
+    if (!setup_metrics(endpoint, registry, opts))
+        return -1;
+    alloc_check allocs;
+    setup_realtime(loop, opts, allocs);
+
+    if (io::rig::result::Ok != boards.begin())
+    {
+        std::cerr << "Failed start rig" << std::endl;
+        perror("");
+        return -1;
+    }
+
+    /** MAIN LOOP **/
+    if (io::reactor::result::Ok != loop.run())
+    {
+        std::cerr << "Event loop failure" << std::endl;
+        perror("");
+        return -1;
+    }
+    return 0;
 }
 
 int main(int argc, char *const argv[])
 {
     using namespace sfx;
+    using clock_type = std::chrono::steady_clock;
+    const auto launched = clock_type::now();
+    auto since_launch = [&]()
+        { return std::chrono::duration_cast<std::chrono::milliseconds>(clock_type::now() - launched).count(); };
 
 #ifndef __ENABLE_TESTING__
-    if (argc != 3)
+    options opts;
+    if (!parse_options(argc, argv, opts))
     {
         usage();
         return -1;
     }
+    if (std::string(argv[1]) == "--rig")
+        return run_rig(argv[2], opts);
+    bool debug = opts.debug;
 
-    io::serial::config config;
+    /** The board boots at the first rate and switches on request **/
+    int baudrate = 0;
     {
-        config.port = argv[1];
         std::stringstream ss;
         ss << argv[2];
-        ss >> config.baudrate;
+        ss >> baudrate;
+    }
+    auto link_speed = midi::baudrate_index(baudrate);
+    if (!link_speed.has_value())
+    {
+        std::cerr << "Unsupported baudrate, use one of :";
+        for (auto b : sysex::baudrates)
+            std::cerr << ' ' << b;
+        std::cerr << std::endl;
+        return -1;
     }
 
+    io::serial::config config = opts.link;
+    config.port = argv[1];
+    config.baudrate = sysex::baudrates[0];
+
     io::serial serial;
     if (config && io::serial::result::Ok != serial.begin(config))
 
@@ -46,6 +324,16 @@ int main(int argc, char *const argv[])
         perror("");
         return -1;
     }
+    /** The board switches as soon as it acks, the host must follow : make
+     *  sure the port takes that rate before asking for it **/
+    if (config && link_speed.value() != 0
+        && (io::serial::result::Ok != serial.set_baudrate(baudrate)
+            || io::serial::result::Ok != serial.set_baudrate(sysex::baudrates[0])))
+    {
+        std::cerr << "Port cannot run at " << baudrate << " bauds" << std::endl;
+        perror("");
+        return -1;
+    }
 #else
 
     using object_type = int;
@@ -107,48 +395,339 @@ int main(int argc, char *const argv[])
 
 #endif
 #ifndef __ENABLE_TESTING__
-    /** Let the arduino wake up **/
-    usleep(1000000);
+    /** Outlives every instrumented object and thread **/
+    io::metrics::registry registry;
+    io::reactor loop;
+    if (io::reactor::result::Ok != loop.begin())
+    {
+        std::cerr << "Failed create event loop" << std::endl;
+        perror("");
+        return -1;
+    }
 
-    /** MAIN LOOP **/
-    while (io::serial::status::Active == serial.state())
+    auto post = [&](const midi::message& msg)
     {
+        std::byte buffer[midi::sysex_capacity + 2];
+        auto n = midi::encode(msg, buffer);
+        if (io::serial::result::Ok != serial.post(std::span(buffer, n)))
+            std::cerr << "Outbound queue full" << std::endl;
+    };
+
+    /** State shared with reader threads, published once per parsed batch **/
+    datastore::store params;
+    auto link_baudrate = *params.add<int32_t>("link.baudrate", int32_t(sysex::baudrates[0]));
+    params.add<bool>("link.debug", debug);
+    datastore::board state;
+    state.copy_params(params);
+    io::snapshot<datastore::board> published(state);
+    auto publish = [&]()
+    {
+        state.copy_params(params);
+        state.batch += 1;
+        published.publish(state);
+    };
+
+    /** Link setup, once the board presented itself. Until the link speed
+     *  settles, periodic work is held **/
+    bool presented = false;
+    bool negotiating = true;
+    bool first_event = false;
+
+    /** An ack that never comes, from an older firmware or lost, must not
+     *  hold the periodic work forever : the link stays at the boot rate **/
+    const auto negotiation_deadline = std::chrono::milliseconds(500);
+    int negotiation = -1;
+    auto settle = [&]()
+    {
+        negotiating = false;
+        if (negotiation >= 0)
+            loop.cancel(negotiation);
+        negotiation = -1;
+    };
+    auto negotiate = [&]()
+    {
+        negotiating = true;
+        post(midi::command(sysex::Baudrate, {link_speed.value()}));
+        if (negotiation >= 0)
+            loop.cancel(negotiation);
+        negotiation = loop.every(negotiation_deadline, [&](uint64_t)
         {
-            auto [code, msg] = serial.receive(64);
-            if (io::serial::result::Ok != code)
-            {
-                std::cerr << "Receive failure" << std::endl;
-                perror("");
-                serial.end();
-                break;
-            }
-            /** DEBUG **/
-            if (msg.size() != 0)
+            std::cerr << "No baudrate ack after " << negotiation_deadline.count()
+                      << "ms, staying at " << sysex::baudrates[0] << " bauds" << std::endl;
+            settle();
+        }).second;
+    };
+    /** Presentation, asked until it comes. A board reset while the link
+     *  is at the boot rate presents itself again and is set up anew ; once
+     *  the link switched, the host stays at that rate and a reset board
+     *  is not heard until the bridge is restarted **/
+    auto on_present = [&](const midi::message& msg)
+    {
+        if (!presented)
+        {
+            std::cout << "Board ";
+            for (auto c : midi::arguments(msg))
+                std::cout << char(c);
+            std::cout << " present after " << since_launch() << "ms" << std::endl;
+        }
+        presented = true;
+        if (debug)
+            post(midi::command(sysex::Debug, {1}));
+        if (link_speed.value() != 0)
+            negotiate();
+        else
+            settle();
+    };
+
+    /** Board acknowledged a speed change, follow it **/
+    auto on_baudrate = [&](const midi::message& msg)
+    {
+        auto args = midi::arguments(msg);
+        /* a late ack is followed as well, the board did switch */
+        settle();
+        if (args.size() != 1 || uint8_t(args[0]) != link_speed.value())
+        {
+            std::cerr << "Board refused baudrate " << baudrate << std::endl;
+            return;
+        }
+        if (io::serial::result::Ok != serial.set_baudrate(baudrate))
+        {
+            std::cerr << "Failed switch baudrate" << std::endl;
+            perror("");
+            return;
+        }
+        params.set(link_baudrate, int32_t(baudrate));
+        std::cout << "Link at " << baudrate << " bauds" << std::endl;
+    };
+
+    /** End to end latency of event records, per kind, against the board clock **/
+    midi::clock_sync clock;
+    midi::histogram latencies[2];
+    /** Receive path : reader, parser, then console printing on its own
+     *  thread and link control on this one **/
+    io::pipeline rx;
+    io::capture recording;
+    rx.attach("console", [](const io::pipeline::event& e) { dispatch(e.msg); });
+    rx.attach_polled("control");
+
+    auto report = [&]()
+    {
+        for (const auto& s : rx.metrics())
+        {
+            const auto& f = s.figures;
+            std::cout << "Stage " << s.name << " : n=" << f.items
+                      << " depth=" << s.depth << "/" << s.capacity << " peak=" << f.peak
+                      << " p50=" << f.p50 / 1000. << "us"
+                      << " p99=" << f.p99 / 1000. << "us"
+                      << " max=" << f.max / 1000. << "us"
+                      << " dropped=" << f.dropped << " stalls=" << f.stalls << std::endl;
+        }
+        static const char* names[] = {"SW", "Expr"};
+        for (int k = 0; k < 2; ++k)
+        {
+            const auto& h = latencies[k];
+            if (h.count() == 0)
+                continue;
+            std::cout << "Latency " << names[k] << " : n=" << h.count()
+                      << " p50=" << h.quantile(0.5) << "us"
+                      << " p99=" << h.quantile(0.99) << "us"
+                      << " max=" << h.max() << "us"
+                      << " (round trip " << clock.round_trip() << "us)" << std::endl;
+        }
+    };
+
+    /** Receive threads are joined before the port is closed **/
+    auto shutdown = [&]()
+    {
+        rx.end();
+        if (recording.active())
+        {
+            std::cout << "Captured " << recording.records() << " records, "
+                      << recording.size() << " bytes" << std::endl;
+            recording.end();
+        }
+        serial.end();
+        loop.stop();
+    };
+
+    /** Interrupted from the console : shut down cleanly so the capture is
+     *  trimmed and the metrics socket removed. Blocked before the other
+     *  threads inherit the mask **/
+    sigset_t stop_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    int interrupted = -1;
+    if ((!opts.capture.empty() || !opts.metrics.empty()) && 0 == pthread_sigmask(SIG_BLOCK, &stop_signals, nullptr))
+        interrupted = signalfd(-1, &stop_signals, SFD_CLOEXEC | SFD_NONBLOCK);
+    if (interrupted >= 0)
+        loop.watch(interrupted, EPOLLIN, [&](uint32_t) { shutdown(); });
+
+    /** Serial counters are split between the reader thread and this one **/
+    io::metrics::endpoint endpoint;
+    if (!opts.metrics.empty())
+    {
+        serial.instrument(registry);
+        rx.instrument(registry);
+        loop.instrument(registry);
+    }
+    if (!setup_metrics(endpoint, registry, opts))
+        return -1;
+
+    /** Pipeline threads inherit the scheduling of this one **/
+    alloc_check allocs;
+    setup_realtime(loop, opts, allocs);
+
+    io::pipeline::config rx_config;
+    if (!opts.capture.empty())
+    {
+        if (io::capture::result::Ok != recording.begin({opts.capture}))
+        {
+            std::cerr << "Failed create capture " << opts.capture << std::endl;
+            perror("");
+            return -1;
+        }
+        rx_config.recording = &recording;
+    }
+    if (io::pipeline::result::Ok != rx.begin(serial, rx_config))
+    {
+        std::cerr << "Failed start receive pipeline" << std::endl;
+        perror("");
+        return -1;
+    }
+
+    /** Control sink, built once : converting a capturing lambda on each
+     *  round would allocate **/
+    bool changed = false;
+    const io::pipeline::sink control = [&](const io::pipeline::event& e)
+    {
+        const midi::message& msg = e.msg;
+        int64_t received = e.received / 1000;
+        if (midi::is_command(msg, sysex::Present))
+            return on_present(msg);
+        if (midi::is_command(msg, sysex::Baudrate))
+        {
+            changed = true;
+            return on_baudrate(msg);
+        }
+        if (!first_event && presented && (!msg.is_sysex() || midi::is_command(msg, sysex::Event)))
+        {
+            first_event = true;
+            std::cout << "First event after " << since_launch() << "ms" << std::endl;
+        }
+        changed = state.update(msg) || changed;
+        if (auto p = midi::decode_pong(msg))
+        {
+            clock.pong(*p, received);
+            return;
+        }
+        auto ev = midi::decode_event(msg);
+        if (ev && clock.synced() && (ev->kind == sysex::Switch || ev->kind == sysex::Expression))
+            latencies[ev->kind - sysex::Switch].record(clock.since(ev->time, received));
+    };
+
+    /** Messages for the control sink, or the port died **/
+    loop.watch(rx.notifier(), EPOLLIN, [&](uint32_t)
+    {
+        changed = false;
+        rx.poll(control);
+        if (changed)
+            publish();
+        if (!rx.alive())
+        {
+            std::cerr << "Port hang up" << std::endl;
+            shutdown();
+        }
+    });
+
+    /** The port itself is only watched for room to write, and errors **/
+    loop.watch(serial.fd(), 0, [&](uint32_t events)
+    {
+        if (events & (EPOLLERR | EPOLLHUP))
+        {
+            std::cerr << "Port hang up" << std::endl;
+            shutdown();
+        }
+    });
+
+    /** LEDs state, sent as one frame per round when changed **/
+    midi::led_frame leds;
+
+    /** Clock sync, only event records carry board timestamps **/
+    if (debug)
+        loop.every(std::chrono::milliseconds(100), [&](uint64_t)
+        {
+            if (!negotiating)
+                post(midi::command(sysex::Ping, {clock.ping(midi::host_micros())}));
+        });
+
+    /** Ask the board who it is until it answers : it may have presented
+     *  itself before the port was open, or not be reset by the open at all.
+     *  A query reaching the bootloader only makes it start the sketch **/
+    bool failed = false;
+    int presence = -1;
+    presence = loop.every(std::chrono::milliseconds(250), [&](uint64_t)
+    {
+        if (presented)
+        {
+            loop.cancel(presence);
+            return;
+        }
+        if (opts.wait.count() <= since_launch())
+        {
+            std::cerr << "No presentation from the board after " << opts.wait.count() << "ms" << std::endl;
+            failed = true;
+            shutdown();
+            return;
+        }
+        post(midi::command(sysex::Present));
+    }).second;
+    post(midi::command(sysex::Present));
+
+    /** Debug report every 10s, held while the link speed changes **/
+    if (debug)
+        loop.every(std::chrono::seconds(10), [&](uint64_t)
+        {
+            if (!negotiating)
+                allocs.exempt(report);
+        });
+
+    /** Everything queued during a round goes out in a single write,
+     *  leftovers are resumed once the port is writable again **/
+    bool writing = false;
+    loop.after_dispatch([&]()
+    {
+        if (io::serial::status::Active != serial.state())
+            return;
+        if (!negotiating)
+            if (auto frame = leds.take())
             {
-                if (3 < msg.size() && msg[0] == std::byte(0xF0) && msg[msg.size() - 1] == std::byte(0xF7))
-                {
-                    std::cout << "Sysex" << std::endl;
-                }
-                else
-                {
-                    std::cout << "Received ";
-                    for (auto x : msg)
-                        std::cout << char(x); // << ' ';
-                    std::cout << '\n';
-                }
+                post(*frame);
+                state.leds_on = leds.on();
+                state.leds_blink = leds.blink();
+                publish();
             }
+        if (serial.pending() && io::serial::result::Failed == serial.transmit().first)
+        {
+            std::cerr << "Send failure" << std::endl;
+            perror("");
+            shutdown();
+            return;
         }
-
+        if (writing != serial.pending())
         {
-            uint8_t omsg[] = {0xC0, 0x03, 0x01, 0xC1, 0x0B, 0x00};
-            std::vector<std::byte> adaptor(
-                reinterpret_cast<std::byte *>(&omsg[0]),
-                reinterpret_cast<std::byte *>(&omsg[sizeof(omsg)]));
-            auto [code, len] = serial.send(adaptor);
+            writing = serial.pending();
+            loop.modify(serial.fd(), writing ? uint32_t(EPOLLOUT) : 0u);
         }
+    });
 
-        usleep(1000000);
+    /** MAIN LOOP **/
+    if (io::reactor::result::Ok != loop.run())
+    {
+        std::cerr << "Event loop failure" << std::endl;
+        perror("");
+        return -1;
     }
-    return 0;
+    return failed ? -1 : 0;
 #endif
 }
@@ -0,0 +1,220 @@
+#include "capture.hpp"
+
+#include <chrono>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace sfx {
+  namespace io {
+
+    using namespace capture_format;
+
+    /** capture **/
+
+    capture::result capture::begin(const config& cfg)
+    {
+      end();
+      if (cfg.segment < sizeof(file_header) || cfg.index_every == 0)
+        return result::Failed;
+      _cfg = cfg;
+      _cfg.segment = padded(cfg.segment);
+      _fd = ::open(cfg.path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+      if (_fd < 0)
+        return result::Failed;
+      if (result::Ok != reserve(sizeof(file_header)))
+      {
+        end();
+        return result::Failed;
+      }
+
+      file_header& h = header();
+      std::memcpy(h.magic, magic, sizeof(h.magic));
+      h.version = 1;
+      h.header_size = sizeof(file_header);
+      h.started = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+      h.end = sizeof(file_header);
+      h.last_index = 0;
+      h.records = 0;
+      return result::Ok;
+    }
+
+    void capture::end()
+    {
+      if (_base)
+      {
+        std::size_t length = header().end;
+        msync(_base, length, MS_ASYNC);
+        munmap(_base, _capacity);
+        _base = nullptr;
+        _capacity = 0;
+        if (0 != ftruncate(_fd, off_t(length)))
+          { /* the committed length in the header still bounds readers */ }
+      }
+      if (_fd >= 0)
+      {
+        ::close(_fd);
+        _fd = -1;
+      }
+    }
+
+    capture::result capture::chunk(std::span<const std::byte> bytes, int64_t time)
+    {
+      return append(Chunk, bytes, time);
+    }
+
+    capture::result capture::message(const midi::message& msg, int64_t time)
+    {
+      std::byte buffer[midi::sysex_capacity + 2];
+      std::size_t n = midi::encode(msg, buffer);
+      return append(Message, std::span(buffer, n), time);
+    }
+
+    capture::result capture::append(kind k, std::span<const std::byte> payload, int64_t time)
+    {
+      if (!_base || 0xFFFF < payload.size())
+        return result::Failed;
+      std::size_t offset = header().end;
+      if (result::Ok != reserve(offset + 2 * sizeof(record_header) + sizeof(index_payload) + padded(payload.size())))
+        return result::Failed;
+
+      auto put = [&](kind what, std::span<const std::byte> bytes)
+      {
+        file_header& h = header();
+        record_header r{time, what, uint16_t(bytes.size()), uint32_t(h.records)};
+        std::memcpy(_base + offset, &r, sizeof(r));
+        if (!bytes.empty())
+          std::memcpy(_base + offset + sizeof(r), bytes.data(), bytes.size());
+        std::size_t at = offset;
+        offset += sizeof(r) + padded(bytes.size());
+        /* committed once complete, a reader never sees half a record */
+        h.records += 1;
+        h.end = offset;
+        return at;
+      };
+      put(k, payload);
+
+      if (header().records % _cfg.index_every == 0)
+      {
+        index_payload index{header().last_index, header().records};
+        header().last_index = put(Index, std::as_bytes(std::span(&index, 1)));
+      }
+      return result::Ok;
+    }
+
+    capture::result capture::reserve(std::size_t bytes)
+    {
+      if (bytes <= _capacity)
+        return result::Ok;
+      std::size_t capacity = _capacity + _cfg.segment;
+      while (capacity < bytes)
+        capacity += _cfg.segment;
+      if (0 != ftruncate(_fd, off_t(capacity)))
+        return result::Failed;
+
+      void* p = _base
+        ? mremap(_base, _capacity, capacity, MREMAP_MAYMOVE)
+        : mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+      if (p == MAP_FAILED)
+        return result::Failed;
+      /* fault the new pages in now rather than on the appends */
+      auto* base = static_cast<std::byte*>(p);
+      for (std::size_t i = _capacity; i < capacity; i += 4096)
+        reinterpret_cast<volatile std::byte*>(base)[i] = std::byte(0);
+      _base = base;
+      _capacity = capacity;
+      return result::Ok;
+    }
+
+    /** capture_reader **/
+
+    capture_reader::result capture_reader::open(const std::string& path)
+    {
+      close();
+      int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd < 0)
+        return result::Failed;
+      struct stat st;
+      if (0 != fstat(fd, &st) || std::size_t(st.st_size) < sizeof(file_header))
+      {
+        ::close(fd);
+        return result::Failed;
+      }
+      void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      ::close(fd);
+      if (p == MAP_FAILED)
+        return result::Failed;
+      _base = static_cast<const std::byte*>(p);
+      _length = st.st_size;
+
+      _header = reinterpret_cast<const file_header*>(_base);
+      if (0 != std::memcmp(_header->magic, magic, sizeof(magic))
+          || _header->header_size != sizeof(file_header)
+          || _length < _header->end)
+      {
+        close();
+        return result::Failed;
+      }
+      rewind();
+      return result::Ok;
+    }
+
+    void capture_reader::close()
+    {
+      if (_base)
+        munmap(const_cast<std::byte*>(_base), _length);
+      _base = nullptr;
+      _length = 0;
+      _header = nullptr;
+      _cursor = 0;
+    }
+
+    std::optional<capture_reader::record> capture_reader::at(std::size_t offset) const
+    {
+      if (!_header || _header->end < offset + sizeof(record_header))
+        return std::nullopt;
+      record_header r;
+      std::memcpy(&r, _base + offset, sizeof(r));
+      if (_header->end < offset + sizeof(r) + r.size)
+        return std::nullopt;
+      return record{kind(r.kind), r.time, r.ordinal, std::span(_base + offset + sizeof(r), r.size)};
+    }
+
+    std::optional<capture_reader::record> capture_reader::next()
+    {
+      auto r = at(_cursor);
+      if (r)
+        _cursor += sizeof(record_header) + padded(r->payload.size());
+      return r;
+    }
+
+    void capture_reader::rewind()
+    {
+      _cursor = sizeof(file_header);
+    }
+
+    bool capture_reader::seek(int64_t time)
+    {
+      /* the index chain runs backward from the latest one */
+      for (std::size_t offset = _header ? _header->last_index : 0; offset != 0;)
+      {
+        auto r = at(offset);
+        if (!r || Index != r->kind || r->payload.size() != sizeof(index_payload))
+          return false;
+        if (r->time <= time)
+        {
+          _cursor = offset;
+          return true;
+        }
+        index_payload index;
+        std::memcpy(&index, r->payload.data(), sizeof(index));
+        offset = index.previous;
+      }
+      return false;
+    }
+  }
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "midi.hpp"
+
+#include <span>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+
+namespace sfx {
+  namespace io {
+
+    /**
+     * Binary log of the serial traffic, to look at after a show and to
+     *  replay through the parser or the bridge.
+     *
+     * The file starts with a 64 bytes header followed by records, each a
+     *  16 bytes header then its payload padded to 8 bytes :
+     *   Chunk    bytes as read from the port
+     *   Message  a parsed message, encoded as on the wire
+     *   Index    every index_every records, the previous index offset and
+     *            the count of records before it, so a reader can seek by
+     *            time without scanning the whole log
+     * Times are steady clock ns of the host, as stamped by the reader.
+     * The header holds the committed length, records past it were being
+     *  written when the process died and are ignored.
+     */
+    namespace capture_format {
+
+      static constexpr char magic[8] = {'5', 'F', 'X', 'C', 'A', 'P', 0, 1};
+
+      enum kind : uint16_t { Chunk = 1, Message = 2, Index = 3 };
+
+      struct file_header {
+        char     magic[8];
+        uint32_t version;
+        uint32_t header_size;
+        int64_t  started;      /**< Realtime ns when the capture began */
+        uint64_t end;          /**< Committed length, in bytes */
+        uint64_t last_index;   /**< Offset of the last Index record, 0 if none */
+        uint64_t records;      /**< Count of committed records */
+        uint8_t  reserved[16];
+      };
+      static_assert(sizeof(file_header) == 64, "fixed size header");
+
+      struct record_header {
+        int64_t  time;         /**< Steady clock ns */
+        uint16_t kind;
+        uint16_t size;         /**< Payload bytes, before padding */
+        uint32_t ordinal;      /**< Position of the record in the log */
+      };
+      static_assert(sizeof(record_header) == 16, "fixed size header");
+
+      struct index_payload {
+        uint64_t previous;     /**< Offset of the former Index record, 0 if none */
+        uint64_t records;      /**< Records before this one */
+      };
+
+      inline std::size_t padded(std::size_t n) { return (n + 7) & ~std::size_t(7); }
+    }
+
+    /**
+     * Append only writer of a capture, memory mapped.
+     * The file grows by segments mapped and faulted in at once, so appends
+     *  are plain copies. One writer thread.
+     */
+    class capture {
+    public:
+
+      /** Nested types **/
+      struct config {
+        std::string path;
+        std::size_t segment = 4 << 20;  /**< Growth step, in bytes */
+        std::size_t index_every = 1024; /**< Records between Index records */
+      };
+
+      enum class result { Ok, Failed };
+
+      /** Ctors **/
+      capture() = default;
+      capture(const capture&) = delete;
+      capture& operator= (const capture&) = delete;
+
+      ~capture() { end(); }
+
+      /** Accessors **/
+      bool active() const { return _base != nullptr; }
+      /** Committed bytes and records **/
+      std::size_t size() const { return active() ? header().end : 0; }
+      std::size_t records() const { return active() ? header().records : 0; }
+
+      /** Methods **/
+      /** Create or truncate cfg.path **/
+      result begin(const config& cfg);
+      /** Trim the file to its committed length and close it **/
+      void end();
+
+      result chunk(std::span<const std::byte> bytes, int64_t time);
+      result message(const midi::message& msg, int64_t time);
+
+    private:
+      capture_format::file_header& header() const
+        { return *reinterpret_cast<capture_format::file_header*>(_base); }
+
+      result append(capture_format::kind k, std::span<const std::byte> payload, int64_t time);
+      result reserve(std::size_t bytes);
+
+      config      _cfg;
+      int         _fd = -1;
+      std::byte*  _base = nullptr;
+      std::size_t _capacity = 0;  /**< Mapped bytes */
+    };
+
+    /** Sequential and time based reading of a capture, memory mapped **/
+    class capture_reader {
+    public:
+
+      /** Nested types **/
+      struct record {
+        capture_format::kind       kind;
+        int64_t                    time;
+        uint32_t                   ordinal;
+        std::span<const std::byte> payload;
+      };
+
+      enum class result { Ok, Failed };
+
+      /** Ctors **/
+      capture_reader() = default;
+      capture_reader(const capture_reader&) = delete;
+      capture_reader& operator= (const capture_reader&) = delete;
+
+      ~capture_reader() { close(); }
+
+      /** Accessors **/
+      std::size_t records() const { return _header ? _header->records : 0; }
+      std::size_t size() const { return _header ? _header->end : 0; }
+      int64_t started() const { return _header ? _header->started : 0; }
+
+      /** Methods **/
+      result open(const std::string& path);
+      void close();
+
+      /** Next record, Index ones included, nullopt at the end **/
+      std::optional<record> next();
+      /** Back to the first record **/
+      void rewind();
+      /** Move to the latest Index record at or before time, false if none **/
+      bool seek(int64_t time);
+
+    private:
+      std::optional<record> at(std::size_t offset) const;
+
+      const std::byte*                   _base = nullptr;
+      std::size_t                        _length = 0;
+      const capture_format::file_header* _header = nullptr;
+      std::size_t                        _cursor = 0;
+    };
+  }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "ring.hpp"
+
+#include <span>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+namespace sfx {
+  namespace io {
+
+    /**
+     * io::ring shared by a producer and a consumer thread that sleep
+     *  while it is full, respectively empty.
+     * Waits are std::atomic waits on a counter bumped by the other side,
+     *  so a side only enters the kernel when it actually has to sleep.
+     * Closing wakes both sides : the producer gets no more room, the
+     *  consumer drains what is left then gets nothing.
+     */
+    template <typename T>
+    class channel {
+    public:
+
+      /** Ctors **/
+      explicit channel(std::size_t capacity) : _ring(capacity) {}
+
+      channel(const channel&) = delete;
+      channel& operator= (const channel&) = delete;
+
+      /** Accessors **/
+      std::size_t capacity() const { return _ring.capacity(); }
+      std::size_t size() const { return _ring.size(); }
+      bool closed() const { return _closed.load(std::memory_order_acquire); }
+
+      /** Producer side **/
+
+      /** Free space at the back, waits for some, empty once closed **/
+      std::span<T> writable()
+      {
+        for (;;)
+        {
+          uint32_t seen = _popped.load(std::memory_order_acquire);
+          if (closed())
+            return {};
+          if (auto room = _ring.writable(); !room.empty())
+            return room;
+          _popped.wait(seen, std::memory_order_acquire);
+        }
+      }
+      /** Free space at the back, without waiting **/
+      std::span<T> try_writable() { return closed() ? std::span<T>() : _ring.writable(); }
+      void commit(std::size_t n)
+      {
+        _ring.commit(n);
+        _pushed.fetch_add(1, std::memory_order_release);
+        _pushed.notify_one();
+      }
+
+      /** Consumer side **/
+
+      /** Elements at the front, waits for some, empty once closed and drained **/
+      std::span<const T> readable()
+      {
+        for (;;)
+        {
+          uint32_t seen = _pushed.load(std::memory_order_acquire);
+          if (auto data = _ring.readable(); !data.empty())
+            return data;
+          if (closed())
+            return {};
+          _pushed.wait(seen, std::memory_order_acquire);
+        }
+      }
+      /** Elements at the front, without waiting **/
+      std::span<const T> try_readable() const { return _ring.readable(); }
+      void consume(std::size_t n)
+      {
+        _ring.consume(n);
+        _popped.fetch_add(1, std::memory_order_release);
+        _popped.notify_one();
+      }
+
+      /** Either side, wakes up the other one **/
+      void close()
+      {
+        _closed.store(true, std::memory_order_release);
+        _pushed.fetch_add(1, std::memory_order_release);
+        _pushed.notify_all();
+        _popped.fetch_add(1, std::memory_order_release);
+        _popped.notify_all();
+      }
+
+    private:
+      ring<T>               _ring;
+      std::atomic<uint32_t> _pushed{0}; /**< bumped on commit, consumer waits on it */
+      std::atomic<uint32_t> _popped{0}; /**< bumped on consume, producer waits on it */
+      std::atomic<bool>     _closed{false};
+    };
+  }
+}
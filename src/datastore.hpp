@@ -1,40 +1,124 @@
 #pragma once
 
+#include <new>
+#include <span>
+#include <deque>
 #include <string>
 #include <vector>
 #include <cassert>
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+#include <string_view>
+#include <type_traits>
 #include <unordered_map>
 
 namespace sfx {
     namespace datastore {
 
-        struct entry {
-        
-            struct name_hash {
-                std::size_t operator() (const entry& e) const
-                    { return std::hash<std::string>()(e.name); }
-            };
-            struct name_equal {
-                bool operator() (const entry& a, const entry& b) const
-                    { return a.name == b.name; }
-            };
-          
-            std::string            name;
-            std::string            type;
-            std::vector<std::byte> value;
+        /** Dense identifier of a parameter, assigned in registration order **/
+        using id_type = uint32_t;
+
+        /** Runtime tag of a parameter type, unique per T **/
+        using type_tag = const void*;
+        template <typename T> type_tag tag_of()
+        {
+            static const char tag = 0;
+            return &tag;
+        }
+
+        /** Typed access to a parameter, resolved once at registration **/
+        template <typename T> struct handle {
+            id_type     id;
+            std::size_t offset; /**< of the slot in the arena */
+        };
+
+        /**
+         * Parameter store.
+         * Names are interned to dense ids when a parameter is registered,
+         *  the string is never hashed again afterward. Values live in one
+         *  contiguous arena, each in a slot aligned for its type, and are
+         *  reached in O(1) through their handle.
+         *
+         * Values must be trivially copyable : the arena is moved as raw
+         *  bytes when it grows. References returned by get() are valid until
+         *  the next registration.
+         */
+        class store {
+        public:
 
-            template <typename T> const T& get() const
+            /** Ctors **/
+            store() = default;
+            explicit store(std::size_t arena_hint) { _arena.reserve(arena_hint); }
+
+            /** Register name with initial value, nullopt if name is taken **/
+            template <typename T>
+            std::optional<handle<T>> add(std::string_view name, const T& init = T())
             {
-                assert(sizeof(T) == value.size());
-                return reinterpret_cast<const T*>(value.data());
+                static_assert(std::is_trivially_copyable_v<T>, "values are moved as raw bytes");
+                static_assert(alignof(T) <= alignof(std::max_align_t), "arena alignment exceeded");
+
+                if (_ids.contains(name))
+                    return std::nullopt;
+
+                std::size_t offset = (_arena.size() + alignof(T) - 1) & ~(alignof(T) - 1);
+                _arena.resize(offset + sizeof(T));
+                new (&_arena[offset]) T(init);
+
+                id_type id = static_cast<id_type>(_slots.size());
+                _slots.push_back({offset, tag_of<T>()});
+                _ids.emplace(_names.emplace_back(name), id);
+                return handle<T>{id, offset};
             }
-            template <typename T> void set(const T& t)
+
+            /** Slow path, by name lookup of a registered parameter **/
+            std::optional<id_type> id(std::string_view name) const
             {
-                value.resize(sizeof(T));
-                *reinterpret_cast<T*>(value.data()) = t;
+                auto itr = _ids.find(name);
+                if (itr == _ids.end())
+                    return std::nullopt;
+                return itr->second;
+            }
+            template <typename T>
+            std::optional<handle<T>> find(std::string_view name) const
+            {
+                auto i = id(name);
+                if (!i || _slots[*i].type != tag_of<T>())
+                    return std::nullopt;
+                return handle<T>{*i, _slots[*i].offset};
             }
-        };
 
-        using unordered_map = std::unordered_map<entry, entry::name_hash, entry::name_equal>;
+            /** Fast path, no lookup **/
+            template <typename T> const T& get(handle<T> h) const
+            {
+                assert(h.id < _slots.size() && _slots[h.id].type == tag_of<T>());
+                return *std::launder(reinterpret_cast<const T*>(&_arena[h.offset]));
+            }
+            template <typename T> void set(handle<T> h, const T& t)
+            {
+                assert(h.id < _slots.size() && _slots[h.id].type == tag_of<T>());
+                *std::launder(reinterpret_cast<T*>(&_arena[h.offset])) = t;
+            }
+
+            /** Accessors **/
+            std::size_t size() const { return _slots.size(); }
+            const std::string& name(id_type id) const { return _names[id]; }
+            type_tag type(id_type id) const { return _slots[id].type; }
+            /** Raw bytes of every value, a handle offset indexes them **/
+            std::span<const std::byte> arena() const { return _arena; }
+            std::size_t arena_size() const { return _arena.size(); }
+
+        private:
+            struct slot {
+                std::size_t offset;
+                type_tag    type;
+            };
+
+            /** operator new storage, aligned for any fundamental type **/
+            std::vector<std::byte>  _arena;
+            std::vector<slot>       _slots; /**< indexed by id */
+            std::deque<std::string> _names; /**< indexed by id, never moved so _ids can view them */
+            std::unordered_map<std::string_view, id_type> _ids;
+        };
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,273 @@
+#include "device.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include <unistd.h>
+#include <sys/epoll.h>
+
+namespace sfx {
+  namespace io {
+
+    /** device **/
+
+    device::device(config cfg)
+      : _cfg(std::move(cfg)), _parser(midi::parser_capacity), _label(_cfg.port)
+    {}
+
+    device::result device::open()
+    {
+      if (status::Closed != _state)
+        return result::Failed;
+      /** absent devices are polled, keep serialport_init from reporting them **/
+      if (!plugged())
+        return result::Failed;
+
+      serial::config link = _cfg.link;
+      link.port = _cfg.port;
+      link.baudrate = sysex::baudrates[0];
+      if (serial::result::Ok != _serial.begin(link))
+        return result::Failed;
+
+      /** bytes of a former session must not prefix the first message **/
+      _parser = midi::static_parser(midi::parser_capacity);
+      _name.clear();
+      _label = _cfg.port;
+      _stats = counters();
+      _opened = clock_type::now();
+      _state = status::Identifying;
+      identify();
+      return result::Ok;
+    }
+    void device::close()
+    {
+      _serial.end();
+      _state = status::Closed;
+    }
+    bool device::plugged() const
+    {
+      return 0 == access(_cfg.port.c_str(), R_OK | W_OK);
+    }
+    bool device::refused() const
+    {
+      return !_cfg.name.empty() && !_name.empty() && _name != _cfg.name;
+    }
+
+    bool device::post(const midi::message& msg)
+    {
+      std::byte buffer[midi::sysex_capacity + 2];
+      auto n = midi::encode(msg, buffer);
+      return serial::result::Ok == _serial.post(std::span(buffer, n));
+    }
+    void device::identify()
+    {
+      if (status::Identifying == _state)
+        post(midi::command(sysex::Present));
+    }
+
+    bool device::settle(clock_type::time_point deadline)
+    {
+      if (status::Negotiating != _state || deadline < _asked)
+        return false;
+      _state = status::Ready;
+      return true;
+    }
+
+    bool device::handshake(const midi::message& msg, result& status)
+    {
+      if (midi::is_command(msg, sysex::Present))
+      {
+        /** a board presents itself again after a reset, follow it **/
+        std::string name;
+        for (auto c : midi::arguments(msg))
+          name.push_back(char(c));
+        _name = std::move(name);
+        _label = _name + "@" + _cfg.port;
+        if (refused())
+        {
+          status = result::Refused;
+          return true;
+        }
+
+        auto speed = midi::baudrate_index(_cfg.baudrate);
+        if (speed.value_or(0) == 0 || _serial.cfg().baudrate == _cfg.baudrate)
+          _state = status::Ready;
+        else
+        {
+          _state = status::Negotiating;
+          _asked = clock_type::now();
+          post(midi::command(sysex::Baudrate, {*speed}));
+        }
+        return true;
+      }
+      if (status::Identifying == _state)
+        return true;
+
+      if (status::Negotiating == _state && midi::is_command(msg, sysex::Baudrate))
+      {
+        auto args = midi::arguments(msg);
+        auto speed = midi::baudrate_index(_cfg.baudrate);
+        /** a refused speed leaves the link at the boot rate, still usable **/
+        if (args.size() == 1 && uint8_t(args[0]) == speed
+            && serial::result::Ok != _serial.set_baudrate(_cfg.baudrate))
+          status = result::Failed;
+        _state = status::Ready;
+        return true;
+      }
+      return false;
+    }
+
+    /** rig **/
+
+    std::size_t rig::ready() const
+    {
+      return std::count_if(_devices.begin(), _devices.end(), [](const slot& s)
+        { return device::status::Ready == s.dev->state(); });
+    }
+
+    device& rig::add(device::config cfg)
+    {
+      _devices.push_back(slot{std::make_unique<device>(std::move(cfg))});
+      return *_devices.back().dev;
+    }
+
+    std::pair<rig::result, std::size_t>
+      rig::load(const std::string& path, const device::config& defaults)
+    {
+      std::ifstream file(path);
+      if (!file)
+        return {result::Failed, 0};
+
+      std::size_t number = 0;
+      for (std::string line; std::getline(file, line);)
+      {
+        number += 1;
+        std::istringstream fields(line);
+        device::config cfg = defaults;
+        cfg.name.clear();
+        if (!(fields >> cfg.port) || cfg.port.front() == '#')
+          continue;
+        fields >> cfg.baudrate >> cfg.name;
+        if (!cfg || !midi::baudrate_index(cfg.baudrate))
+          return {result::Failed, number};
+        add(std::move(cfg));
+      }
+      return {result::Ok, number};
+    }
+
+    rig::result rig::begin(std::chrono::milliseconds retry)
+    {
+      if (0 <= _timer)
+        return result::Failed;
+      auto [code, timer] = _loop.every(retry, [this](uint64_t) { this->retry(); });
+      if (reactor::result::Ok != code)
+        return result::Failed;
+      _timer = timer;
+      _retry = retry;
+      for (auto& s : _devices)
+        open(s);
+      return result::Ok;
+    }
+    void rig::end()
+    {
+      if (_timer < 0)
+        return;
+      _loop.cancel(_timer);
+      _timer = -1;
+      for (auto& s : _devices)
+        if (device::status::Closed != s.dev->state())
+          drop(s);
+    }
+
+    void rig::transmit()
+    {
+      for (auto& s : _devices)
+        if (device::status::Closed != s.dev->state())
+          transmit(s);
+    }
+    void rig::transmit(slot& s)
+    {
+      device& d = *s.dev;
+      if (d.link().pending() && serial::result::Failed == d.link().transmit().first)
+      {
+        drop(s);
+        return;
+      }
+      if (s.writing != d.link().pending())
+      {
+        s.writing = d.link().pending();
+        _loop.modify(d.fd(), s.writing ? EPOLLIN | EPOLLOUT : EPOLLIN);
+      }
+    }
+
+    void rig::open(slot& s)
+    {
+      device& d = *s.dev;
+      if (device::result::Ok != d.open())
+        return;
+      /** slots never move once begin() is called, devices are added before **/
+      device* dev = &d;
+      slot* sp = &s;
+      if (reactor::result::Ok != _loop.watch(d.fd(), EPOLLIN, [this, dev, sp](uint32_t events)
+      {
+        auto before = dev->state();
+        auto code = dev->receive([&](const midi::message& msg)
+        {
+          if (_on_message)
+            _on_message(*dev, msg);
+        });
+        if (device::result::Ok != code || (events & (EPOLLERR | EPOLLHUP)))
+        {
+          /** a refused board is left alone until its port goes away **/
+          sp->refused = device::result::Refused == code;
+          drop(*sp);
+        }
+        else
+          changed(*dev, before);
+      }))
+      {
+        d.close();
+        return;
+      }
+      s.writing = false;
+      changed(d, device::status::Closed);
+      /* the presentation request goes out now, not after the next event */
+      transmit(s);
+    }
+
+    void rig::drop(slot& s)
+    {
+      device& d = *s.dev;
+      auto before = d.state();
+      _loop.unwatch(d.fd());
+      d.close();
+      s.writing = false;
+      changed(d, before);
+    }
+
+    void rig::retry()
+    {
+      /* a tick may come early, before a full period elapsed since the request */
+      auto deadline = device::clock_type::now() - _retry;
+      for (auto& s : _devices)
+      {
+        device& d = *s.dev;
+        if (s.refused)
+          s.refused = d.plugged();
+        else if (device::status::Closed == d.state())
+          open(s);
+        else if (d.settle(deadline))
+          changed(d, device::status::Negotiating);
+        else
+          d.identify();
+      }
+    }
+
+    void rig::changed(device& d, device::status before)
+    {
+      if (before != d.state() && _on_state)
+        _on_state(d);
+    }
+  }
+}
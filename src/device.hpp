@@ -0,0 +1,211 @@
+#pragma once
+
+#include "serial-io.hpp"
+#include "reactor.hpp"
+#include "midi.hpp"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+
+namespace sfx {
+  namespace io {
+
+    /**
+     * One pedalboard of a rig : its port, its own parser and the name the
+     *  board gave in its Present message.
+     * The board is asked who it is once the port is open, then on each
+     *  retry until it answers : it may have presented itself before the
+     *  open, or not be reset by it at all, see serial::config::hangup.
+     * Once identified, the link speed is negotiated as the single board
+     *  bridge does, messages are delivered from then on.
+     */
+    class device {
+    public:
+
+      /** Nested types **/
+      struct config {
+        std::string port;
+        int         baudrate = 0; /**< Negotiated once identified */
+        std::string name;         /**< Expected Present name, empty accepts any board */
+        serial::config link;      /**< Receive policy and hang up, port and rate ignored */
+
+        explicit operator bool() const
+          { return baudrate != 0 && port.size() != 0; }
+      };
+
+      enum class status { Closed, Identifying, Negotiating, Ready };
+      enum class result { Ok, Failed, Refused };
+
+      /** Traffic since the port was opened **/
+      struct counters {
+        std::size_t bytes    = 0;
+        std::size_t messages = 0; /**< delivered, handshake excluded */
+      };
+
+      using clock_type = std::chrono::steady_clock;
+
+      /** Ctors **/
+      explicit device(config cfg);
+      device(const device&) = delete;
+      device& operator= (const device&) = delete;
+
+      /** Accessors **/
+      const config& cfg() const { return _cfg; }
+      status state() const { return _state; }
+      /** Name given by the board, empty until identified, kept once closed **/
+      const std::string& name() const { return _name; }
+      /** name@port once identified, the port alone before **/
+      const std::string& label() const { return _label; }
+      int fd() const { return _serial.fd(); }
+      serial& link() { return _serial; }
+      const counters& stats() const { return _stats; }
+      /** True while the port exists and can be opened **/
+      bool plugged() const;
+      /** True when the board presented itself under another name than expected **/
+      bool refused() const;
+      /** When the port was last opened **/
+      clock_type::time_point opened() const { return _opened; }
+
+      /** Methods **/
+      /** Open the port at the boot rate, Failed if absent **/
+      result open();
+      void close();
+
+      /** Queue msg for the board, false if the outbound queue is full **/
+      bool post(const midi::message& msg);
+      /** Ask the board who it is, while identifying **/
+      void identify();
+      /**
+       * Give up a negotiation asked before deadline : the board kept
+       *  silent, the link stays at the boot rate. True if given up.
+       */
+      bool settle(clock_type::time_point deadline);
+
+      /**
+       * Drain the port, feed the parser and call sink(msg) for each message
+       *  of an identified board. Returns Failed once the port is gone and
+       *  Refused if the board is not the expected one.
+       */
+      template <typename Sink>
+      result receive(Sink&& sink)
+      {
+        auto [code, got] = _serial.receive_buffered();
+        _stats.bytes += got;
+        result status = result::Ok;
+        for (auto raw = _serial.buffered(); !raw.empty(); raw = _serial.buffered())
+          _serial.consume(_parser.feed(raw, [&](const midi::message& msg)
+          {
+            if (result::Ok != status || handshake(msg, status))
+              return;
+            _stats.messages += 1;
+            sink(msg);
+          }));
+        if (serial::result::Ok != code)
+          return result::Failed;
+        return status;
+      }
+
+    private:
+      /** True when msg belongs to the handshake, status set on refusal **/
+      bool handshake(const midi::message& msg, result& status);
+
+      config                 _cfg;
+      serial                 _serial;
+      midi::static_parser    _parser;
+      status                 _state = status::Closed;
+      std::string            _name;
+      std::string            _label;
+      counters               _stats;
+      clock_type::time_point _opened;
+      clock_type::time_point _asked;   /**< When the Baudrate request was posted */
+    };
+
+    /**
+     * Pedalboards multiplexed on one reactor.
+     * Each device is watched on its own descriptor and parsed by its own
+     *  parser, so a silent or unplugged board never delays the others.
+     * Absent and hung up devices are retried on a timer, boards may be
+     *  plugged and unplugged while the others keep running.
+     */
+    class rig {
+    public:
+
+      /** Nested types **/
+      using message_handler = std::function<void(device&, const midi::message&)>;
+      using state_handler = std::function<void(device&)>;
+
+      enum class result { Ok, Failed };
+
+      /** Ctors **/
+      explicit rig(reactor& loop) : _loop(loop) {}
+      rig(const rig&) = delete;
+      rig& operator= (const rig&) = delete;
+
+      ~rig() { end(); }
+
+      /** Accessors **/
+      std::size_t size() const { return _devices.size(); }
+      device& operator[] (std::size_t i) { return *_devices[i].dev; }
+      /** Count of identified devices **/
+      std::size_t ready() const;
+
+      /** Devices, to add before begin() **/
+      device& add(device::config cfg);
+      /**
+       * Add the devices listed in a file, one per line as
+       *  port baudrate [name]
+       * other settings are taken from defaults. Blank lines and lines
+       *  starting with # are skipped. Returns the number of the first
+       *  malformed line, 0 if the file is unreadable.
+       */
+      std::pair<result, std::size_t>
+        load(const std::string& path, const device::config& defaults);
+      std::pair<result, std::size_t>
+        load(const std::string& path) { return load(path, device::config()); }
+
+      /** Handlers, called from the reactor thread **/
+      void on_message(message_handler h) { _on_message = std::move(h); }
+      /** Called on every status change of a device **/
+      void on_state(state_handler h) { _on_state = std::move(h); }
+
+      /** Methods **/
+      /**
+       * Open present devices now, then look for the others every retry.
+       *  A board silent for a retry period after the Baudrate request is
+       *  Ready at the boot rate.
+       */
+      result begin(std::chrono::milliseconds retry = std::chrono::seconds(1));
+      void end();
+
+      /** Write what devices queued this round, to call from after_dispatch **/
+      void transmit();
+
+    private:
+
+      struct slot {
+        std::unique_ptr<device> dev;
+        bool                    writing = false; /**< Watched for EPOLLOUT */
+        bool                    refused = false; /**< Not reopened while plugged */
+      };
+
+      void open(slot& s);
+      void drop(slot& s);
+      void transmit(slot& s);
+      void retry();
+      void changed(device& d, device::status before);
+
+      reactor&                  _loop;
+      std::vector<slot>         _devices;
+      int                       _timer = -1;
+      std::chrono::milliseconds _retry{0};
+      message_handler           _on_message;
+      state_handler             _on_state;
+    };
+  }
+}
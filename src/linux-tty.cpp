@@ -0,0 +1,40 @@
+#include "linux-tty.hpp"
+
+#include <asm/termbits.h>  // termios2, BOTHER
+#include <linux/serial.h>  // serial_struct, ASYNC_LOW_LATENCY
+#include <sys/ioctl.h>
+
+namespace sfx {
+  namespace io {
+    namespace linux_tty {
+
+      bool set_baudrate(int fd, int baudrate, bool drain)
+      {
+        termios2 toptions;
+        if (-1 == ioctl(fd, TCGETS2, &toptions))
+          return false;
+        toptions.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+        toptions.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+        toptions.c_ispeed = baudrate;
+        toptions.c_ospeed = baudrate;
+        if (-1 == ioctl(fd, drain ? TCSETSW2 : TCSETS2, &toptions))
+          return false;
+
+        /* drivers round the divisor, refuse rates too far from the request */
+        if (-1 == ioctl(fd, TCGETS2, &toptions))
+          return false;
+        long error = long(toptions.c_ospeed) - baudrate;
+        return (error < 0 ? -error : error) * 50 <= baudrate;
+      }
+
+      bool set_low_latency(int fd)
+      {
+        serial_struct serial;
+        if (-1 == ioctl(fd, TIOCGSERIAL, &serial))
+          return false;
+        serial.flags |= ASYNC_LOW_LATENCY;
+        return -1 != ioctl(fd, TIOCSSERIAL, &serial);
+      }
+    }
+  }
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+namespace sfx {
+  namespace io {
+
+    /**
+     * Linux specific tty ioctls. They live in their own translation unit :
+     *  the kernel termios2 definitions clash with the glibc <termios.h>.
+     */
+    namespace linux_tty {
+
+      /**
+       * Any rate through termios2 and BOTHER, for rates without a Bxxx
+       *  constant. drain lets bytes already written go out at the former
+       *  rate first. False if the driver refuses the rate.
+       */
+      bool set_baudrate(int fd, int baudrate, bool drain);
+
+      /** Ask the driver to push received bytes at once, false if unsupported **/
+      bool set_low_latency(int fd);
+    }
+  }
+}
@@ -0,0 +1,251 @@
+#include "metrics.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <cinttypes>
+#include <algorithm>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+
+namespace sfx {
+  namespace io {
+    namespace metrics {
+
+      namespace {
+        /** Remove path if it is a socket, true if it is gone **/
+        bool unlink_socket(const std::string& path)
+        {
+          struct stat st;
+          if (0 != lstat(path.c_str(), &st))
+            return errno == ENOENT;
+          if (!S_ISSOCK(st.st_mode))
+          {
+            errno = EEXIST;
+            return false;
+          }
+          return 0 == unlink(path.c_str()) || errno == ENOENT;
+        }
+      }
+
+      /** histogram **/
+
+      histogram::figures histogram::read() const
+      {
+        figures f;
+        f.max = _max.load(std::memory_order_relaxed);
+        std::array<uint64_t, layout::buckets_count> counts;
+        for (std::size_t i = 0; i < counts.size(); ++i)
+          f.count += counts[i] = _buckets[i].load(std::memory_order_relaxed);
+        if (f.count == 0)
+          return f;
+
+        auto quantile = [&](double q) -> int64_t
+        {
+          uint64_t rank = uint64_t(q * (f.count - 1)) + 1, seen = 0;
+          for (std::size_t i = 0; i < counts.size(); ++i)
+            if (rank <= (seen += counts[i]))
+              return std::min(layout::upper_bound(i), f.max);
+          return f.max;
+        };
+        f.p50 = quantile(0.5);
+        f.p99 = quantile(0.99);
+        f.p999 = quantile(0.999);
+        return f;
+      }
+
+      /** registry **/
+
+      registry::registry()
+        : _started(clock_type::now()), _ticked(_started)
+      {}
+
+      registry::entry* registry::find(const std::string& name, kind type)
+      {
+        for (auto& e : _entries)
+          if (e.name == name && e.type == type)
+            return &e;
+        return nullptr;
+      }
+
+      counter& registry::add_counter(const std::string& name)
+      {
+        std::lock_guard lock(_mutex);
+        if (entry* e = find(name, kind::Counter))
+          return _counters[e->index];
+        _entries.push_back({name, kind::Counter, _counters.size()});
+        return _counters.emplace_back();
+      }
+
+      gauge& registry::add_gauge(const std::string& name)
+      {
+        std::lock_guard lock(_mutex);
+        if (entry* e = find(name, kind::Gauge))
+          return _gauges[e->index];
+        _entries.push_back({name, kind::Gauge, _gauges.size()});
+        return _gauges.emplace_back();
+      }
+
+      histogram& registry::add_histogram(const std::string& name)
+      {
+        std::lock_guard lock(_mutex);
+        if (entry* e = find(name, kind::Histogram))
+          return _histograms[e->index];
+        _entries.push_back({name, kind::Histogram, _histograms.size()});
+        return _histograms.emplace_back();
+      }
+
+      void registry::tick()
+      {
+        std::lock_guard lock(_mutex);
+        auto now = clock_type::now();
+        double dt = std::chrono::duration<double>(now - _ticked).count();
+        _ticked = now;
+        for (auto& e : _entries)
+          if (kind::Counter == e.type)
+          {
+            uint64_t v = _counters[e.index].value();
+            e.rate = 0 < dt ? (v - e.last) / dt : 0;
+            e.last = v;
+          }
+      }
+
+      std::string registry::snapshot() const
+      {
+        std::string out;
+        snapshot(out);
+        return out;
+      }
+
+      void registry::snapshot(std::string& out) const
+      {
+        std::lock_guard lock(_mutex);
+        char line[256];
+        auto append = [&](int n)
+          { out.append(line, std::min<std::size_t>(std::max(n, 0), sizeof(line) - 1)); };
+
+        out.clear();
+        append(std::snprintf(line, sizeof(line), "# uptime %.3fs\n",
+          std::chrono::duration<double>(clock_type::now() - _started).count()));
+        for (const auto& e : _entries)
+          switch (e.type)
+          {
+          case kind::Counter:
+            append(std::snprintf(line, sizeof(line), "counter %s %" PRIu64 " %.1f/s\n",
+              e.name.c_str(), _counters[e.index].value(), e.rate));
+            break;
+          case kind::Gauge:
+            append(std::snprintf(line, sizeof(line), "gauge %s %" PRId64 "\n",
+              e.name.c_str(), _gauges[e.index].value()));
+            break;
+          case kind::Histogram:
+          {
+            auto f = _histograms[e.index].read();
+            append(std::snprintf(line, sizeof(line),
+              "histogram %s count=%" PRIu64 " p50=%" PRId64 " p99=%" PRId64 " p99.9=%" PRId64 " max=%" PRId64 "\n",
+              e.name.c_str(), f.count, f.p50, f.p99, f.p999, f.max));
+            break;
+          }
+          }
+      }
+
+      /** endpoint **/
+
+      endpoint::result endpoint::begin(registry& r, const std::string& path, std::chrono::milliseconds period)
+      {
+        end();
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (sizeof(addr.sun_path) <= path.size())
+          return result::Failed;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+        _listen = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        _stop = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (_listen < 0 || _stop < 0)
+        {
+          end();
+          return result::Failed;
+        }
+        /* a socket left behind by a former run that did not shut down,
+         *  anything else at path is not ours to remove */
+        if (!unlink_socket(path) || 0 != bind(_listen, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) || 0 != listen(_listen, 4))
+        {
+          end();
+          return result::Failed;
+        }
+        _path = path;
+        _registry = &r;
+        /* enough for a rig of dozens of boards, dumps then never allocate */
+        _text.reserve(64 << 10);
+        _thread = std::thread([this, period]() { serve(period); });
+        return result::Ok;
+      }
+
+      void endpoint::end()
+      {
+        if (_thread.joinable())
+        {
+          uint64_t one = 1;
+          if (sizeof(one) != write(_stop, &one, sizeof(one)))
+            { /* already signaled */ }
+          _thread.join();
+        }
+        for (int* fd : {&_listen, &_stop})
+          if (*fd >= 0)
+          {
+            close(*fd);
+            *fd = -1;
+          }
+        if (!_path.empty())
+          unlink_socket(_path);
+        _path.clear();
+        _registry = nullptr;
+      }
+
+      void endpoint::serve(std::chrono::milliseconds period)
+      {
+        using clock_type = std::chrono::steady_clock;
+        pollfd fds[2] = {{_listen, POLLIN, 0}, {_stop, POLLIN, 0}};
+        auto next = clock_type::now() + period;
+        for (;;)
+        {
+          auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next - clock_type::now());
+          int n = ::poll(fds, 2, std::max<int>(0, wait.count()));
+          if (n < 0 && errno != EINTR)
+            break;
+          if (fds[1].revents)
+            break;
+          if (next <= clock_type::now())
+          {
+            _registry->tick();
+            next += period;
+          }
+          if (0 < n && (fds[0].revents & POLLIN))
+          {
+            int client = accept4(_listen, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client < 0)
+              continue;
+            /* a reader that does not drain gives up the rest, not this thread */
+            timeval timeout{0, 100000};
+            setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            _registry->snapshot(_text);
+            for (std::size_t done = 0; done < _text.size();)
+            {
+              ssize_t w = send(client, _text.data() + done, _text.size() - done, MSG_NOSIGNAL);
+              if (w <= 0)
+                break;
+              done += w;
+            }
+            close(client);
+          }
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include "timing.hpp"
+
+#include <array>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <cstdint>
+#include <cstddef>
+
+namespace sfx {
+  namespace io {
+
+    /**
+     * Instrumentation of the bridge, read from outside the I/O thread.
+     *
+     * Each metric has one writer thread, which updates it with relaxed
+     *  loads and stores only, no read-modify-write : recording costs about
+     *  a plain increment and never waits. Any thread may read it.
+     * Metrics are created by a registry, at startup or when a board is
+     *  plugged, and stay at the same address until the registry dies.
+     */
+    namespace metrics {
+
+      namespace detail {
+        template <typename T>
+        void bump(std::atomic<T>& a, T n)
+          { a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+      }
+
+      class counter {
+      public:
+        void add(uint64_t n = 1) { detail::bump(_value, n); }
+        uint64_t value() const { return _value.load(std::memory_order_relaxed); }
+
+      private:
+        std::atomic<uint64_t> _value{0};
+      };
+
+      class gauge {
+      public:
+        void set(int64_t v) { _value.store(v, std::memory_order_relaxed); }
+        int64_t value() const { return _value.load(std::memory_order_relaxed); }
+
+      private:
+        std::atomic<int64_t> _value{0};
+      };
+
+      /**
+       * Log linear histogram, the midi::histogram bucket layout : values
+       *  are kept within 1/8 of their magnitude, from 0 to 2^32.
+       */
+      class histogram {
+      public:
+
+        /** Nested types **/
+        using layout = midi::histogram;
+
+        struct figures {
+          uint64_t count = 0;
+          int64_t  p50   = 0;
+          int64_t  p99   = 0;
+          int64_t  p999  = 0;
+          int64_t  max   = 0;
+        };
+
+        /** Methods **/
+        void record(int64_t value)
+        {
+          if (value < 0)
+            value = 0;
+          if (_max.load(std::memory_order_relaxed) < value)
+            _max.store(value, std::memory_order_relaxed);
+          detail::bump(_buckets[layout::bucket_of(uint64_t(value))], uint64_t(1));
+        }
+
+        /** Quantiles are bucket upper bounds, capped by the max **/
+        figures read() const;
+
+      private:
+        std::array<std::atomic<uint64_t>, layout::buckets_count> _buckets{};
+        std::atomic<int64_t> _max{0};
+      };
+
+      /**
+       * Named metrics and their text dump.
+       * Creating a metric and dumping take a lock, updating one does not.
+       */
+      class registry {
+      public:
+
+        /** Ctors **/
+        registry();
+        registry(const registry&) = delete;
+        registry& operator= (const registry&) = delete;
+
+        /** Methods **/
+        /** Names are dotted paths, "serial.rx.bytes" ; a name used twice
+         *  returns the existing metric, a board plugged again goes on counting **/
+        counter& add_counter(const std::string& name);
+        gauge& add_gauge(const std::string& name);
+        histogram& add_histogram(const std::string& name);
+
+        /** Sample counters, the rates dumped are those over the last period **/
+        void tick();
+        /**
+         * One metric per line, in creation order :
+         *   counter <name> <value> <per second>
+         *   gauge <name> <value>
+         *   histogram <name> count=n p50=v p99=v p99.9=v max=v
+         */
+        std::string snapshot() const;
+        /** Same, into out whose capacity is reused : no allocation once warm **/
+        void snapshot(std::string& out) const;
+
+      private:
+        using clock_type = std::chrono::steady_clock;
+
+        enum class kind { Counter, Gauge, Histogram };
+
+        struct entry {
+          std::string name;
+          kind        type;
+          std::size_t index;     /**< in the storage of its kind */
+          uint64_t    last = 0;  /**< counter value at the last tick */
+          double      rate = 0;
+        };
+
+        entry* find(const std::string& name, kind type);
+
+        mutable std::mutex    _mutex;
+        std::deque<entry>     _entries;
+        std::deque<counter>   _counters;
+        std::deque<gauge>     _gauges;
+        std::deque<histogram> _histograms;
+        clock_type::time_point _started;
+        clock_type::time_point _ticked;
+      };
+
+      /**
+       * Unix domain socket serving registry snapshots, on its own thread.
+       * Each connection gets one snapshot then is closed :
+       *   nc -U /tmp/5fx.metrics
+       * The thread also ticks the registry every period. Start it before
+       *  io::realtime::enter() so it stays time shared.
+       */
+      class endpoint {
+      public:
+
+        /** Nested types **/
+        enum class result { Ok, Failed };
+
+        /** Ctors **/
+        endpoint() = default;
+        endpoint(const endpoint&) = delete;
+        endpoint& operator= (const endpoint&) = delete;
+
+        ~endpoint() { end(); }
+
+        /** Methods **/
+        /** Bind path, replacing a stale socket, and start serving ; fails
+         *  if path is any other file **/
+        result begin(registry& r, const std::string& path,
+                     std::chrono::milliseconds period = std::chrono::seconds(1));
+        /** Stop serving and remove the socket file **/
+        void end();
+
+      private:
+        void serve(std::chrono::milliseconds period);
+
+        registry*   _registry = nullptr;
+        std::string _path;
+        std::string _text;        /**< Snapshot buffer, kept between clients */
+        int         _listen = -1;
+        int         _stop = -1;   /**< eventfd */
+        std::thread _thread;
+      };
+    }
+  }
+}
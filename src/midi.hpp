@@ -0,0 +1,235 @@
+#pragma once
+
+#include "parser.hpp"
+#include "static-parser.hpp"
+#include "sysex.hpp"
+
+#include <span>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+#include <algorithm>
+#include <initializer_list>
+
+namespace sfx {
+namespace midi {
+
+/** Maximum count of data bytes kept from a SysEx **/
+static constexpr std::size_t sysex_capacity = 32;
+
+/** Parser buffer capacity, fits the longest message accepted **/
+static constexpr std::size_t parser_capacity = 2 * (sysex_capacity + 2);
+
+/** Message exchanged with the pedalboard **/
+struct message {
+    std::byte status; /**< Status byte, channel included */
+    uint8_t   size;   /**< Count of data bytes */
+    std::array<std::byte, sysex_capacity> data; /**< Without status nor EOX */
+
+    bool is_sysex() const { return status == std::byte(0xF0); }
+    uint8_t channel() const
+        { return static_cast<uint8_t>(status & std::byte(0x0F)); }
+};
+
+using parser = io::parser<message>;
+
+/** Validator for 3 bytes control messages (0xC0 - 0xCF) **/
+inline parser::result control_change(
+    parser::raw_citerator begin, parser::raw_citerator end)
+{
+    if (end - begin < 3)
+        return parser::result();
+
+    if (bool(*(begin + 1) & std::byte(0x80)))
+        return parser::result(1, std::nullopt);
+    if (bool(*(begin + 2) & std::byte(0x80)))
+        return parser::result(2, std::nullopt);
+
+    message msg{*begin, 2, {}};
+    msg.data[0] = *(begin + 1);
+    msg.data[1] = *(begin + 2);
+    return parser::result(3, std::make_optional(msg));
+}
+
+/** Validator for SysEx, too long payloads are rejected **/
+inline parser::result sysex(
+    parser::raw_citerator begin, parser::raw_citerator end)
+{
+    auto itr = std::find_if(begin + 1, end, [](std::byte b) -> bool
+                            { return bool(b & std::byte(0x80)); });
+    if (itr == end)
+        return parser::result();
+    if (*itr != std::byte(0xF7))
+        return parser::result(itr - begin, std::nullopt);
+
+    std::size_t size = itr - begin - 1;
+    if (sysex_capacity < size)
+        return parser::result(itr - begin + 1, std::nullopt);
+
+    message msg{*begin, static_cast<uint8_t>(size), {}};
+    std::copy(begin + 1, itr, msg.data.begin());
+    return parser::result(itr - begin + 1, std::make_optional(msg));
+}
+
+/** Serialize msg into out, returns count of bytes written, 0 if too small **/
+inline std::size_t encode(const message& msg, std::span<std::byte> out)
+{
+    std::size_t size = msg.size + 1 + (msg.is_sysex() ? 1 : 0);
+    if (out.size() < size)
+        return 0;
+    out[0] = msg.status;
+    std::copy_n(msg.data.begin(), msg.size, out.begin() + 1);
+    if (msg.is_sysex())
+        out[size - 1] = std::byte(0xF7);
+    return size;
+}
+
+/** Pedalboard SysEx, data is manufacturer[2] command args... **/
+inline bool is_command(const message& msg, sysex::command cmd)
+{
+    return msg.is_sysex() && sysex::header_size <= msg.size
+        && msg.data[0] == std::byte(sysex::manufacturer[0])
+        && msg.data[1] == std::byte(sysex::manufacturer[1])
+        && msg.data[2] == std::byte(cmd);
+}
+inline std::span<const std::byte> arguments(const message& msg)
+{
+    std::size_t size = msg.size < sysex::header_size ? 0 : msg.size - sysex::header_size;
+    return {msg.data.data() + sysex::header_size, size};
+}
+inline message command(sysex::command cmd, std::initializer_list<uint8_t> args = {})
+{
+    message msg{std::byte(sysex::start), sysex::header_size, {
+        std::byte(sysex::manufacturer[0]),
+        std::byte(sysex::manufacturer[1]),
+        std::byte(cmd)}};
+    for (auto a : args)
+        msg.data[msg.size++] = std::byte(a & 0x7F);
+    return msg;
+}
+
+/** State of every LED in one message, bit i of on lights LED i, bit i of blink makes it blink **/
+inline message leds(uint16_t on, uint16_t blink = 0)
+{
+    static_assert(sysex::leds_bitmap_size == 2, "bitmaps are encoded on two bytes");
+    return command(sysex::Leds, {
+        uint8_t(on & 0x7F), uint8_t(on >> 7),
+        uint8_t(blink & 0x7F), uint8_t(blink >> 7)});
+}
+
+/**
+ * Host copy of the board LEDs.
+ * LEDs are set one by one, the whole frame is then sent as a single Leds
+ *  message, and only when something changed since the last one.
+ */
+class led_frame {
+public:
+    enum state : uint8_t { Off = 0, On = 1, Blink = 2 };
+
+    void set(uint8_t i, state s)
+    {
+        uint16_t on = s == On ? _on | (1u << i) : _on & ~(1u << i);
+        uint16_t blink = s == Blink ? _blink | (1u << i) : _blink & ~(1u << i);
+        _dirty = _dirty || on != _on || blink != _blink;
+        _on = on;
+        _blink = blink;
+    }
+
+    uint16_t on() const { return _on; }
+    uint16_t blink() const { return _blink; }
+
+    /** Message to send, nullopt when the board is up to date **/
+    std::optional<message> take()
+    {
+        if (!_dirty)
+            return std::nullopt;
+        _dirty = false;
+        return leds(_on, _blink);
+    }
+
+private:
+    uint16_t _on = 0;
+    uint16_t _blink = 0;
+    bool     _dirty = true; /**< board state is unknown until a first frame */
+};
+
+/** Board timestamp, see sysex::time_mask **/
+inline uint32_t decode_time(std::span<const std::byte> bytes)
+{
+    uint32_t time = 0;
+    for (std::size_t i = 0; i < sysex::time_size; ++i)
+        time = (time << 7) | uint32_t(bytes[i]);
+    return time;
+}
+
+/** Binary debug record sent by the firmware along with changes **/
+struct event {
+    sysex::event_kind kind;
+    uint8_t           id;
+    uint16_t          value; /**< 14 bits */
+    uint32_t          time;  /**< board micros() at detection, 28 bits */
+};
+inline std::optional<event> decode_event(const message& msg)
+{
+    if (!is_command(msg, sysex::Event) || arguments(msg).size() != 4 + sysex::time_size)
+        return std::nullopt;
+    auto args = arguments(msg);
+    return event{
+        static_cast<sysex::event_kind>(args[0]),
+        static_cast<uint8_t>(args[1]),
+        static_cast<uint16_t>((uint16_t(args[2]) << 7) | uint16_t(args[3])),
+        decode_time(args.subspan(4))};
+}
+
+/** Answer of the board to a ping **/
+struct pong {
+    uint8_t  sequence;
+    uint32_t time; /**< board micros() when the ping was processed, 28 bits */
+};
+inline std::optional<pong> decode_pong(const message& msg)
+{
+    if (!is_command(msg, sysex::Ping) || arguments(msg).size() != 1 + sysex::time_size)
+        return std::nullopt;
+    auto args = arguments(msg);
+    return pong{static_cast<uint8_t>(args[0]), decode_time(args.subspan(1))};
+}
+
+/** Index of baudrate in sysex::baudrates, nullopt if unsupported **/
+inline std::optional<uint8_t> baudrate_index(int baudrate)
+{
+    for (uint8_t i = 0; i < sysex::baudrates_count; ++i)
+        if (sysex::baudrates[i] == static_cast<uint32_t>(baudrate))
+            return i;
+    return std::nullopt;
+}
+
+/** Protocol spoken by the pedalboard firmware **/
+inline parser::protocol protocol()
+{
+    parser::protocol p{{std::byte(0xF0), sysex}};
+    for (int i = 0xC0; i <= 0xCF; ++i)
+        p.emplace(std::byte(i), control_change);
+    return p;
+}
+
+/** Same protocol, resolved at compile time **/
+struct control_change_rule {
+    static constexpr bool accepts(std::byte status)
+        { return (status & std::byte(0xF0)) == std::byte(0xC0); }
+    static parser::result parse(
+        parser::raw_citerator begin, parser::raw_citerator end)
+        { return control_change(begin, end); }
+};
+struct sysex_rule {
+    static constexpr bool accepts(std::byte status)
+        { return status == std::byte(0xF0); }
+    static parser::result parse(
+        parser::raw_citerator begin, parser::raw_citerator end)
+        { return sysex(begin, end); }
+};
+
+using static_parser = io::static_parser<message, control_change_rule, sysex_rule>;
+
+} /**< namespace midi **/
+} /**< namespace sfx **/
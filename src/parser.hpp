@@ -1,5 +1,6 @@
 #pragma once
 
+#include <span>
 #include <vector>
 #include <utility>
 #include <cstdint>
@@ -7,14 +8,23 @@
 #include <optional>
 #include <variant>
 #include <cassert>
+#include <algorithm>
 #include <functional>
+#include <type_traits>
 #include <unordered_map>
 
 namespace sfx {
 namespace io {
 
-template <typename Object>
-class parser {
+/**
+ * Buffering and cursor logic shared by every parser flavour.
+ * Derived provides the status byte dispatch through
+ *  std::optional<result> dispatch(raw_citerator begin, raw_citerator end) const
+ *  returning nullopt if no validator handles *begin, and
+ *  std::size_t rules_count() const
+ */
+template <typename Object, typename Derived>
+class basic_parser {
 public:
 
     using object_type = Object;
@@ -35,24 +45,17 @@ public:
     enum class code { Ok, InvalidHeader, InvalidPayload, Incomplete };
 
     using result = std::pair<std::size_t, std::optional<Object>>;
-    using validator = std::function<
-            result(raw_citerator begin, raw_citerator end)
-        >;
-
-    using protocol = std::unordered_map<std::byte, validator>;
 
     /** Ctors **/
-    explicit parser(
-        const protocol& p = protocol(),
-        std::size_t hint = sizeof(Object))
-        : _protocol(p), _buffer()
+    /** hint is the initial buffer capacity, also the one used by feed() **/
+    explicit basic_parser(std::size_t hint)
+        : _buffer(), _cursor(0)
         { _buffer.reserve(hint); }
 
     /** Accessors **/
-    const protocol& cfg() const { return _protocol; }
     status state() const 
     {
-        if (_protocol.size() == 0)
+        if (derived().rules_count() == 0)
             return status::Dead;
         else
             return is_running()
@@ -61,7 +64,7 @@ public:
                 ;
     }
 
-    bool is_running() const { return 0 != _buffer.size(); }
+    bool is_running() const { return _cursor != _buffer.size(); }
 
     /** Methods **/
     std::vector<Object>
@@ -69,9 +72,75 @@ public:
     {
         assert(state() != status::Dead);
         _buffer.insert(_buffer.end(), v.cbegin(), v.cend());
-    
+
         std::vector<Object> res;
-        buffer_iterator pos(_buffer.cbegin());
+        auto sink = [&res](const Object& o) { res.emplace_back(o); };
+        parse(sink);
+        compact();
+
+        return res;
+    }
+
+    /**
+     * Streaming interface, never allocates.
+     * Input is appended to the buffer without growing it past its capacity,
+     *  each parsed object is passed to sink(const Object&). If sink is also
+     *  invocable with a code, it is notified of rejected bytes.
+     * Messages longer than the capacity are dropped.
+     * Returns the count of bytes consumed, always the whole input.
+     */
+    template <typename Sink>
+    std::size_t feed(std::span<const std::byte> input, Sink&& sink)
+    {
+        assert(state() != status::Dead);
+        assert(0 != _buffer.capacity());
+
+        std::size_t done = 0;
+        while (done < input.size())
+        {
+            if (_buffer.size() == _buffer.capacity())
+                compact();
+            if (_buffer.size() == _buffer.capacity())
+            {
+                /** pending message cannot fit, drop its header to resync **/
+                _cursor += 1;
+                notify(sink, code::InvalidPayload);
+                parse(sink);
+                continue;
+            }
+
+            std::size_t n = std::min(
+                input.size() - done, _buffer.capacity() - _buffer.size());
+            _buffer.insert(_buffer.end(),
+                input.begin() + done, input.begin() + done + n);
+            done += n;
+            parse(sink);
+        }
+        return done;
+    }
+
+protected:
+    ~basic_parser() = default;
+
+private:
+    using buffer_type = std::vector<std::byte>;
+    using buffer_iterator = buffer_type::const_iterator;
+
+    const Derived& derived() const
+        { return static_cast<const Derived&>(*this); }
+
+    template <typename Sink>
+    static void notify(Sink& sink, code c)
+    {
+        if constexpr (std::is_invocable_v<Sink&, code>)
+            sink(c);
+    }
+
+    /** Parse from the read cursor, stops on incomplete message **/
+    template <typename Sink>
+    void parse(Sink& sink)
+    {
+        buffer_iterator pos(_buffer.cbegin() + _cursor);
         while (pos != _buffer.cend()) {
             auto [itr, var] = try_parse(pos, _buffer.cend());
 
@@ -79,32 +148,37 @@ public:
             {
                 if (std::get<code>(var) == code::Incomplete)
                     break;
+                notify(sink, std::get<code>(var));
             }
             else
-                res.emplace_back(std::get<Object>(var));
+                sink(std::get<Object>(var));
             pos = itr;
         }
-
-        auto tmp = buffer_type(pos, _buffer.cend());
-        std::swap(_buffer, tmp);
-
-        return res;
+        _cursor = pos - _buffer.cbegin();
+        if (_cursor == _buffer.size())
+        {
+            _buffer.clear();
+            _cursor = 0;
+        }
     }
 
-private:
-    using buffer_type = std::vector<std::byte>;
-    using buffer_iterator = buffer_type::const_iterator;
+    /** Move pending bytes to the front of the buffer, never allocates **/
+    void compact()
+    {
+        _buffer.erase(_buffer.begin(), _buffer.begin() + _cursor);
+        _cursor = 0;
+    }
     
     std::pair<buffer_iterator, std::variant<code, Object>>
         try_parse(raw_citerator begin, raw_citerator end) const
     {
         assert(is_running());
 
-        auto itr = _protocol.find(*begin);
-        if (itr == _protocol.end())
+        auto dispatched = derived().dispatch(begin, end);
+        if (!dispatched.has_value())
             { return {begin+1, code::InvalidHeader}; }
 
-        auto [len, res] = itr->second(begin, end);
+        auto& [len, res] = dispatched.value();
         
         if (res.has_value())
             return {raw_citerator(begin+len), res.value()};
@@ -115,8 +189,53 @@ private:
                 return {begin+len, code::InvalidPayload};
     }
 
-    protocol    _protocol;
     buffer_type _buffer;
+    std::size_t _cursor; /**< Read position in _buffer */
+};
+
+/**
+ * Parser whose protocol is a runtime table of type erased validators.
+ */
+template <typename Object>
+class parser : public basic_parser<Object, parser<Object>> {
+public:
+
+    using base = basic_parser<Object, parser<Object>>;
+    using typename base::result;
+    using typename base::raw_citerator;
+
+    /** Nested types **/
+    using validator = std::function<
+            result(raw_citerator begin, raw_citerator end)
+        >;
+
+    using protocol = std::unordered_map<std::byte, validator>;
+
+    /** Ctors **/
+    explicit parser(
+        const protocol& p = protocol(),
+        std::size_t hint = sizeof(Object))
+        : base(hint), _protocol(p)
+        {}
+
+    /** Accessors **/
+    const protocol& cfg() const { return _protocol; }
+
+private:
+    friend base;
+
+    std::size_t rules_count() const { return _protocol.size(); }
+
+    std::optional<result>
+        dispatch(raw_citerator begin, raw_citerator end) const
+    {
+        auto itr = _protocol.find(*begin);
+        if (itr == _protocol.end())
+            return std::nullopt;
+        return itr->second(begin, end);
+    }
+
+    protocol _protocol;
 };
 
 } /**< namespace io **/
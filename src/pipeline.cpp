@@ -0,0 +1,318 @@
+#include "pipeline.hpp"
+#include "capture.hpp"
+
+#include <chrono>
+#include <cerrno>
+#include <utility>
+#include <type_traits>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+namespace sfx {
+  namespace io {
+
+    namespace {
+      int64_t now_ns()
+      {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count();
+      }
+    }
+
+    /** stage_stats **/
+
+    void stage_stats::record(std::size_t depth, int64_t latency)
+    {
+      bump(_items);
+      if (_peak.load(std::memory_order_relaxed) < depth)
+        _peak.store(depth, std::memory_order_relaxed);
+      _latency.record(latency);
+    }
+
+    stage_stats::figures stage_stats::read() const
+    {
+      figures f;
+      f.items = _items.load(std::memory_order_relaxed);
+      f.dropped = _dropped.load(std::memory_order_relaxed);
+      f.stalls = _stalls.load(std::memory_order_relaxed);
+      f.peak = _peak.load(std::memory_order_relaxed);
+      auto latency = _latency.read();
+      f.p50 = latency.p50;
+      f.p99 = latency.p99;
+      f.max = latency.max;
+      return f;
+    }
+
+    /** pipeline **/
+
+    void pipeline::attach(std::string name, sink s)
+    {
+      auto out = std::make_unique<output>();
+      out->name = std::move(name);
+      out->fn = std::move(s);
+      _outputs.push_back(std::move(out));
+    }
+
+    void pipeline::attach_polled(std::string name)
+    {
+      attach(std::move(name), sink());
+    }
+
+    void pipeline::instrument(metrics::registry& r)
+    {
+      _probes.bytes = &r.add_counter("parser.bytes");
+      _probes.messages = &r.add_counter("parser.messages");
+      _probes.invalid_header = &r.add_counter("parser.invalid_header");
+      _probes.invalid_payload = &r.add_counter("parser.invalid_payload");
+    }
+
+    pipeline::result pipeline::begin(serial& port, config cfg)
+    {
+      if (serial::status::Active != port.state())
+        return result::Failed;
+      _stop = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+      _notifier = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+      if (_stop < 0 || _notifier < 0)
+      {
+        end();
+        return result::Failed;
+      }
+
+      _port = &port;
+      _recording = cfg.recording;
+      _chunks = std::make_unique<channel<chunk>>(cfg.chunks);
+      for (auto& out : _outputs)
+        out->queue = std::make_unique<channel<event>>(cfg.events);
+      _alive.store(true, std::memory_order_release);
+
+      for (auto& out : _outputs)
+        if (out->fn)
+          out->thread = std::thread([this, o = out.get()]() { dispatch_loop(*o); });
+      _parser_thread = std::thread([this]() { parse_loop(); });
+      _reader_thread = std::thread([this]() { read_loop(); });
+      return result::Ok;
+    }
+
+    void pipeline::end()
+    {
+      if (_stop >= 0)
+      {
+        uint64_t one = 1;
+        if (sizeof(one) != write(_stop, &one, sizeof(one)))
+          { /* the reader still stops once the chunks channel is closed */ }
+      }
+      if (_chunks)
+        _chunks->close();
+      if (_reader_thread.joinable())
+        _reader_thread.join();
+      if (_parser_thread.joinable())
+        _parser_thread.join();
+      for (auto& out : _outputs)
+        if (out->thread.joinable())
+          out->thread.join();
+
+      for (int* fd : {&_stop, &_notifier})
+        if (*fd >= 0)
+        {
+          close(*fd);
+          *fd = -1;
+        }
+      _port = nullptr;
+      _recording = nullptr;
+      _alive.store(false, std::memory_order_release);
+    }
+
+    std::size_t pipeline::poll(const sink& s)
+    {
+      uint64_t count;
+      if (_notifier >= 0 && read(_notifier, &count, sizeof(count)) < 0)
+        { /* nothing signaled, queues are drained anyway */ }
+
+      std::size_t done = 0;
+      for (auto& out : _outputs)
+      {
+        if (out->fn || !out->queue)
+          continue;
+        for (auto batch = out->queue->try_readable(); !batch.empty(); batch = out->queue->try_readable())
+        {
+          std::size_t depth = out->queue->size();
+          for (const auto& e : batch)
+          {
+            out->stats.record(depth--, now_ns() - e.received);
+            s(e);
+          }
+          out->queue->consume(batch.size());
+          done += batch.size();
+        }
+      }
+      return done;
+    }
+
+    std::vector<pipeline::stage_figures> pipeline::metrics() const
+    {
+      std::vector<stage_figures> figures;
+      std::size_t chunks = _chunks ? _chunks->capacity() : 0;
+      /* the reader input is the kernel buffer, its depth is unknown ; its
+         latency runs from the poll wake up, not from the bytes arrival */
+      figures.push_back({"reader", 0, 0, _reader.read()});
+      figures.push_back({"parser", _chunks ? _chunks->size() : 0, chunks, _parser.read()});
+      for (const auto& out : _outputs)
+        figures.push_back({
+          out->name,
+          out->queue ? out->queue->size() : 0,
+          out->queue ? out->queue->capacity() : 0,
+          out->stats.read()});
+      return figures;
+    }
+
+    void pipeline::notify()
+    {
+      uint64_t one = 1;
+      if (sizeof(one) != write(_notifier, &one, sizeof(one)))
+        { /* counter saturated, the owner is already signaled */ }
+    }
+
+    void pipeline::read_loop()
+    {
+      pollfd fds[2] = {{_port->fd(), POLLIN, 0}, {_stop, POLLIN, 0}};
+      const auto coalesce = _port->cfg().coalesce;
+      bool drained = true; /**< last read emptied the port, a new burst starts */
+      for (;;)
+      {
+        if (::poll(fds, 2, -1) < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          _alive.store(false, std::memory_order_release);
+          break;
+        }
+        const int64_t woken = now_ns();
+        if (fds[1].revents)
+          break;
+        if (!(fds[0].revents & POLLIN))
+        {
+          /* hang up or error, with nothing left to read */
+          _alive.store(false, std::memory_order_release);
+          break;
+        }
+        const bool hungup = fds[0].revents & (POLLHUP | POLLERR);
+        /* a backlog is read at once, only the start of a burst waits */
+        if (drained && 0 < coalesce.count())
+          std::this_thread::sleep_for(coalesce);
+
+        auto room = _chunks->try_writable();
+        if (room.empty())
+        {
+          /* parser behind, bytes wait in the kernel buffer meanwhile */
+          _reader.stall();
+          room = _chunks->writable();
+          if (room.empty())
+            break;
+        }
+        chunk& c = room.front();
+        auto [code, got] = _port->receive(c.data);
+        if (serial::result::Ok != code)
+        {
+          _alive.store(false, std::memory_order_release);
+          break;
+        }
+        drained = got.size() < c.data.size();
+        if (got.empty())
+        {
+          /* readable yet nothing to read : a hung up tty, unplugged, polls
+           *  so forever and would spin this thread, starving the others
+           *  of a realtime core */
+          _alive.store(false, std::memory_order_release);
+          break;
+        }
+        c.received = now_ns();
+        c.size = got.size();
+        /* from wake up to read : coalescing and waits on the parser */
+        _reader.record(_chunks->size(), c.received - woken);
+        _chunks->commit(1);
+        if (hungup && drained)
+        {
+          /* the last bytes of a hung up port are delivered, then it is dead */
+          _alive.store(false, std::memory_order_release);
+          break;
+        }
+      }
+      _chunks->close();
+    }
+
+    void pipeline::parse_loop()
+    {
+      midi::static_parser parser(midi::parser_capacity);
+      for (auto batch = _chunks->readable(); !batch.empty(); batch = _chunks->readable())
+      {
+        bool polled = false;
+        std::size_t depth = _chunks->size();
+        for (const auto& c : batch)
+        {
+          _parser.record(depth--, now_ns() - c.received);
+          auto bytes = std::span(c.data).first(c.size);
+          if (_recording)
+            _recording->chunk(bytes, c.received);
+          if (_probes.bytes)
+            _probes.bytes->add(bytes.size());
+          parser.feed(bytes, [&](const auto& parsed)
+          {
+            if constexpr (std::is_same_v<std::decay_t<decltype(parsed)>, midi::static_parser::code>)
+            {
+              /* rejected bytes, the parser resyncs on the next status byte */
+              metrics::counter* rejected = midi::static_parser::code::InvalidHeader == parsed
+                ? _probes.invalid_header
+                : _probes.invalid_payload;
+              if (rejected)
+                rejected->add();
+            }
+            else
+              deliver(parsed, c.received, polled);
+          });
+        }
+        _chunks->consume(batch.size());
+        if (polled)
+          notify();
+      }
+      for (auto& out : _outputs)
+        out->queue->close();
+      notify();
+    }
+
+    void pipeline::deliver(const midi::message& msg, int64_t received, bool& polled)
+    {
+      if (_probes.messages)
+        _probes.messages->add();
+      if (_recording)
+        _recording->message(msg, received);
+      for (auto& out : _outputs)
+      {
+        auto room = out->queue->try_writable();
+        if (room.empty())
+        {
+          out->stats.drop();
+          continue;
+        }
+        room.front() = event{msg, received};
+        out->queue->commit(1);
+        polled = polled || !out->fn;
+      }
+    }
+
+    void pipeline::dispatch_loop(output& out)
+    {
+      for (auto batch = out.queue->readable(); !batch.empty(); batch = out.queue->readable())
+      {
+        std::size_t depth = out.queue->size();
+        for (const auto& e : batch)
+        {
+          out.stats.record(depth--, now_ns() - e.received);
+          out.fn(e);
+        }
+        out.queue->consume(batch.size());
+      }
+    }
+  }
+}
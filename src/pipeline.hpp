@@ -0,0 +1,176 @@
+#pragma once
+
+#include "channel.hpp"
+#include "metrics.hpp"
+#include "serial-io.hpp"
+#include "midi.hpp"
+#include "timing.hpp"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+
+namespace sfx {
+  namespace io {
+
+    class capture;
+
+    /** Figures of a pipeline stage, written by its own thread, read from any **/
+    class stage_stats {
+    public:
+
+      /** Nested types **/
+      struct figures {
+        uint64_t items   = 0;   /**< chunks or messages handled */
+        uint64_t dropped = 0;   /**< lost on a full input queue */
+        uint64_t stalls  = 0;   /**< waits on a full output queue */
+        uint64_t peak    = 0;   /**< deepest input queue seen */
+        int64_t  p50     = 0;   /**< latency since the bytes were read, in ns */
+        int64_t  p99     = 0;
+        int64_t  max     = 0;
+      };
+
+      /** Writer side, an item left the input queue depth deep **/
+      void record(std::size_t depth, int64_t latency);
+      void drop() { bump(_dropped); }
+      void stall() { bump(_stalls); }
+
+      /** Any thread **/
+      figures read() const;
+
+    private:
+      static void bump(std::atomic<uint64_t>& a, uint64_t n = 1)
+        { a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+
+      std::atomic<uint64_t> _items{0};
+      std::atomic<uint64_t> _dropped{0};
+      std::atomic<uint64_t> _stalls{0};
+      std::atomic<uint64_t> _peak{0};
+      metrics::histogram    _latency;
+    };
+
+    /**
+     * Receive path of the bridge, split in threads so a slow consumer
+     *  never delays draining the port :
+     *   reader     drains the port into fixed size, timestamped chunks
+     *   parser     turns chunks into midi messages
+     *   dispatcher one thread per sink, or the owner thread for the polled
+     *              sink, which it drains with poll()
+     * Stages are connected by single producer single consumer channels.
+     * Reader and parser wait on a full queue, the kernel buffer absorbing
+     *  the burst; a full sink queue drops the message for that sink only,
+     *  so a stalled sink cannot hold the others.
+     *
+     * The reader only calls serial::receive(), the owner thread keeps
+     *  posting and transmitting through the same serial.
+     * A capture, when configured, is written by the parser thread : every
+     *  chunk then the messages parsed out of it.
+     */
+    class pipeline {
+    public:
+
+      /** Nested types **/
+      struct config {
+        std::size_t chunks = 64;   /**< reader to parser queue, in chunks */
+        std::size_t events = 1024; /**< parser to each sink queue, in messages */
+        capture*    recording = nullptr;
+      };
+
+      struct event {
+        midi::message msg;
+        int64_t       received; /**< steady clock ns, when its last bytes were read */
+      };
+      using sink = std::function<void(const event&)>;
+
+      enum class result { Ok, Failed };
+
+      struct stage_figures {
+        std::string          name;
+        std::size_t          depth;    /**< input queue, now */
+        std::size_t          capacity; /**< input queue */
+        stage_stats::figures figures;
+      };
+
+      /** Ctors **/
+      pipeline() = default;
+      pipeline(const pipeline&) = delete;
+      pipeline& operator= (const pipeline&) = delete;
+
+      ~pipeline() { end(); }
+
+      /** Sinks, to attach before begin() **/
+      /** s runs on its own dispatcher thread **/
+      void attach(std::string name, sink s);
+      /** Messages are kept for the owner thread, see notifier() **/
+      void attach_polled(std::string name);
+      /** Count parsed bytes, messages and rejects, before begin() **/
+      void instrument(metrics::registry& r);
+
+      /** Methods **/
+      result begin(serial& port, config cfg);
+      result begin(serial& port) { return begin(port, config()); }
+      /** Stop and join every stage, the port is left open **/
+      void end();
+
+      /** Readable once messages wait for the polled sink or the port died **/
+      int notifier() const { return _notifier; }
+      /** Run s on the messages waiting for the polled sink, returns count **/
+      std::size_t poll(const sink& s);
+      /** False once the port hung up or failed **/
+      bool alive() const { return _alive.load(std::memory_order_acquire); }
+
+      /** Every stage, in data flow order **/
+      std::vector<stage_figures> metrics() const;
+
+    private:
+
+      struct chunk {
+        int64_t                    received; /**< steady clock ns */
+        std::size_t                size;
+        std::array<std::byte, 256> data;
+      };
+
+      struct output {
+        std::string                     name;
+        sink                            fn;     /**< empty for the polled sink */
+        std::unique_ptr<channel<event>> queue;
+        stage_stats                     stats;
+        std::thread                     thread;
+      };
+
+      /** Parser side probes, unset until instrument() **/
+      struct probes {
+        metrics::counter* bytes = nullptr;
+        metrics::counter* messages = nullptr;
+        metrics::counter* invalid_header = nullptr;
+        metrics::counter* invalid_payload = nullptr;
+      };
+
+      void read_loop();
+      void parse_loop();
+      /** Queue msg for every sink, polled is set if the owner must be woken **/
+      void deliver(const midi::message& msg, int64_t received, bool& polled);
+      void dispatch_loop(output& out);
+      void notify();
+
+      serial*                              _port = nullptr;
+      std::unique_ptr<channel<chunk>>      _chunks;
+      stage_stats                          _reader;
+      stage_stats                          _parser;
+      std::vector<std::unique_ptr<output>> _outputs;
+      capture*                             _recording = nullptr;
+      probes                               _probes;
+      std::thread                          _reader_thread;
+      std::thread                          _parser_thread;
+      int                                  _stop = -1;     /**< eventfd, wakes the reader up */
+      int                                  _notifier = -1; /**< eventfd, wakes the owner up */
+      std::atomic<bool>                    _alive{false};
+    };
+  }
+}
@@ -0,0 +1,176 @@
+#include "reactor.hpp"
+#include "metrics.hpp"
+
+#include <unistd.h>       // UNIX standard function definitions
+#include <errno.h>        // Error number definitions
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#include <chrono>
+#include <cassert>
+
+namespace sfx {
+  namespace io {
+
+    reactor::result reactor::begin()
+    {
+      if (status::Dead != state()) return result::Failed;
+      _epoll = epoll_create1(EPOLL_CLOEXEC);
+      if (_epoll < 0) return result::Failed;
+
+      assert(status::Idle == state());
+      return result::Ok;
+    }
+    void reactor::end()
+    {
+      if (status::Dead == state()) return;
+      for (auto& [fd, s] : _slots)
+        if (s->timer)
+          close(fd);
+      _slots.clear();
+      _graveyard.clear();
+      close(_epoll);
+      _epoll = -1;
+      _running = false;
+      assert(status::Dead == state());
+    }
+
+    reactor::result reactor::watch(int fd, uint32_t events, callback cb)
+    {
+      assert(status::Dead != state());
+      auto s = std::make_unique<slot>(slot{fd, false, std::move(cb)});
+
+      epoll_event ev{};
+      ev.events = events;
+      ev.data.ptr = s.get();
+      if (-1 == epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &ev))
+        return result::Failed;
+
+      _slots[fd] = std::move(s);
+      return result::Ok;
+    }
+    reactor::result reactor::modify(int fd, uint32_t events)
+    {
+      assert(status::Dead != state());
+      auto itr = _slots.find(fd);
+      if (itr == _slots.end())
+        return result::Failed;
+
+      epoll_event ev{};
+      ev.events = events;
+      ev.data.ptr = itr->second.get();
+      if (-1 == epoll_ctl(_epoll, EPOLL_CTL_MOD, fd, &ev))
+        return result::Failed;
+      return result::Ok;
+    }
+    reactor::result reactor::unwatch(int fd)
+    {
+      assert(status::Dead != state());
+      auto itr = _slots.find(fd);
+      if (itr == _slots.end())
+        return result::Failed;
+
+      epoll_ctl(_epoll, EPOLL_CTL_DEL, fd, nullptr);
+      /** slot may still be referenced by pending events of this round **/
+      itr->second->fd = -1;
+      _graveyard.emplace_back(std::move(itr->second));
+      _slots.erase(itr);
+      return result::Ok;
+    }
+
+    std::pair<reactor::result, int>
+      reactor::every(std::chrono::nanoseconds period, timer_callback cb)
+    {
+      assert(status::Dead != state());
+      int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+      if (fd < 0)
+        return {result::Failed, -1};
+
+      itimerspec spec{};
+      spec.it_interval.tv_sec  = period.count() / 1000000000;
+      spec.it_interval.tv_nsec = period.count() % 1000000000;
+      spec.it_value = spec.it_interval;
+      if (-1 == timerfd_settime(fd, 0, &spec, nullptr))
+      {
+        close(fd);
+        return {result::Failed, -1};
+      }
+
+      auto wrapper = [fd, cb = std::move(cb)](uint32_t)
+      {
+        uint64_t expirations = 0;
+        if (sizeof(expirations) == read(fd, &expirations, sizeof(expirations)))
+          cb(expirations);
+      };
+      if (result::Ok != watch(fd, EPOLLIN, std::move(wrapper)))
+      {
+        close(fd);
+        return {result::Failed, -1};
+      }
+      _slots[fd]->timer = true;
+      return {result::Ok, fd};
+    }
+    reactor::result reactor::cancel(int timer)
+    {
+      auto itr = _slots.find(timer);
+      if (itr == _slots.end() || !itr->second->timer)
+        return result::Failed;
+      unwatch(timer);
+      close(timer);
+      return result::Ok;
+    }
+
+    void reactor::instrument(metrics::registry& r, const std::string& prefix)
+    {
+      _probes.wakeups = &r.add_counter(prefix + ".wakeups");
+      _probes.events = &r.add_counter(prefix + ".events");
+      _probes.dispatch = &r.add_histogram(prefix + ".dispatch_ns");
+    }
+
+    std::pair<reactor::result, int>
+      reactor::run_once(int timeout /* = -1 */)
+    {
+      assert(status::Dead != state());
+      epoll_event events[max_events];
+      int n = epoll_wait(_epoll, events, max_events, timeout);
+      if (n < 0)
+        return {errno == EINTR ? result::Ok : result::Failed, 0};
+      std::chrono::steady_clock::time_point woken;
+      if (_probes.dispatch)
+        woken = std::chrono::steady_clock::now();
+
+      for (int i = 0; i < n; ++i)
+      {
+        auto s = static_cast<slot*>(events[i].data.ptr);
+        if (0 <= s->fd)
+          s->cb(events[i].events);
+      }
+      _graveyard.clear();
+      if (0 < n && _after)
+        _after();
+
+      if (_probes.dispatch && 0 < n)
+      {
+        _probes.wakeups->add();
+        _probes.events->add(n);
+        _probes.dispatch->record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - woken).count());
+      }
+      return {result::Ok, n};
+    }
+    reactor::result reactor::run()
+    {
+      _running = true;
+      while (_running)
+      {
+        auto [code, n] = run_once();
+        if (result::Ok != code)
+        {
+          _running = false;
+          return code;
+        }
+      }
+      return result::Ok;
+    }
+  }
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <utility>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <unordered_map>
+
+namespace sfx {
+  namespace io {
+
+    namespace metrics {
+      class counter;
+      class histogram;
+      class registry;
+    }
+
+    /**
+     * Single threaded event loop built on epoll.
+     * File descriptors are watched for readiness and periodic work is
+     *  driven by timerfds, so the loop only wakes up when there is
+     *  something to do.
+     */
+    class reactor {
+    public:
+
+      /** Nested types **/
+      using callback = std::function<void(uint32_t events)>;
+      using timer_callback = std::function<void(uint64_t expirations)>;
+
+      enum class status { Dead, Idle, Running };
+      enum class result { Ok, Failed };
+
+      /** Ctors **/
+      reactor() = default;
+      reactor(const reactor&) = delete;
+      reactor& operator= (const reactor&) = delete;
+
+      ~reactor() { end(); }
+
+      /** Accessors **/
+      status state() const
+      {
+        if (_epoll < 0)
+          return status::Dead;
+        else
+          return _running
+            ? status::Running
+            : status::Idle
+            ;
+      }
+
+      /** Methods **/
+      result begin();
+      void end();
+
+      /** Watch given fd for events (EPOLLIN, EPOLLOUT, ...) **/
+      result watch(int fd, uint32_t events, callback cb);
+      /** Change the events watched on an already registered fd **/
+      result modify(int fd, uint32_t events);
+      /** Stop watching given fd, it is not closed **/
+      result unwatch(int fd);
+
+      /** Call cb every period, returns the underlying timerfd **/
+      std::pair<result, int>
+      every(std::chrono::nanoseconds period, timer_callback cb);
+      /** Cancel and close a timer created by every() **/
+      result cancel(int timer);
+
+      /**
+       * Publish <prefix>.wakeups, <prefix>.events and <prefix>.dispatch_ns,
+       *  the time from epoll_wait returning to the end of the round : an
+       *  event waits that long at most behind the others of its round.
+       */
+      void instrument(metrics::registry& r, const std::string& prefix = "loop");
+
+      /** Call cb once all events of a round have been dispatched **/
+      void after_dispatch(std::function<void()> cb) { _after = std::move(cb); }
+
+      /** Wait at most timeout ms for events and dispatch them, -1 blocks **/
+      std::pair<result, int> run_once(int timeout = -1);
+      /** Dispatch events until stop() is called or an error occurs **/
+      result run();
+      void stop() { _running = false; }
+
+    private:
+
+      /** Unset until instrument() **/
+      struct probes {
+        metrics::counter*   wakeups = nullptr;
+        metrics::counter*   events = nullptr;
+        metrics::histogram* dispatch = nullptr;
+      };
+
+      struct slot {
+        int      fd;
+        bool     timer;
+        callback cb;
+      };
+
+      static constexpr int max_events = 16;
+
+      int  _epoll   = -1;
+      bool _running = false;
+      std::unordered_map<int, std::unique_ptr<slot>> _slots;
+      std::vector<std::unique_ptr<slot>> _graveyard; /**< Unwatched during dispatch */
+      std::function<void()> _after;
+      probes _probes;
+    };
+  }
+}
@@ -0,0 +1,95 @@
+#include "realtime.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <sched.h>
+#include <malloc.h>
+#include <alloca.h>
+#include <sys/mman.h>
+
+namespace sfx {
+  namespace io {
+    namespace realtime {
+
+      namespace {
+        /** Touch size bytes of stack below the caller, once locked they stay resident **/
+        __attribute__((noinline)) void prefault_stack(std::size_t size)
+        {
+          volatile char* p = static_cast<volatile char*>(alloca(size));
+          for (std::size_t i = 0; i < size; i += 4096)
+            p[i] = 0;
+        }
+
+        /** Grow the heap by size and keep it, freed blocks are then reused without faults **/
+        bool prefault_heap(std::size_t size)
+        {
+          /* no trimming nor mmap'ed blocks, they would be returned to the system */
+          if (!mallopt(M_TRIM_THRESHOLD, -1) || !mallopt(M_MMAP_MAX, 0))
+            return false;
+          char* p = static_cast<char*>(std::malloc(size));
+          if (!p)
+            return false;
+          for (std::size_t i = 0; i < size; i += 4096)
+            p[i] = 0;
+          std::free(p);
+          return true;
+        }
+      }
+
+      std::string report::str() const
+      {
+        std::string s;
+        auto step = [&](const char* name, int code)
+        {
+          if (!s.empty())
+            s += ", ";
+          s += name;
+          s += code == 0 ? " ok" : std::string(" failed (") + std::strerror(code) + ")";
+        };
+        step("memory lock", locked);
+        step("cpu pinning", pinned);
+        step("fifo scheduling", scheduled);
+        step("prefault", prefaulted);
+        return s;
+      }
+
+      report enter(const config& cfg)
+      {
+        report r;
+        /* current and future mappings, buffers allocated later included */
+        r.locked = 0 == mlockall(MCL_CURRENT | MCL_FUTURE) ? 0 : errno;
+
+        r.pinned = 0;
+        if (0 <= cfg.cpu)
+        {
+          cpu_set_t set;
+          CPU_ZERO(&set);
+          CPU_SET(cfg.cpu, &set);
+          r.pinned = 0 == sched_setaffinity(0, sizeof(set), &set) ? 0 : errno;
+        }
+
+        sched_param param{};
+        param.sched_priority = cfg.priority;
+        r.scheduled = 0 == sched_setscheduler(0, SCHED_FIFO, &param) ? 0 : errno;
+
+        prefault_stack(cfg.stack);
+        r.prefaulted = prefault_heap(cfg.heap) ? 0 : ENOMEM;
+        return r;
+      }
+
+      void leave()
+      {
+        sched_param param{};
+        sched_setscheduler(0, SCHED_OTHER, &param);
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int i = 0; i < CPU_SETSIZE; ++i)
+          CPU_SET(i, &set);
+        sched_setaffinity(0, sizeof(set), &set);
+        munlockall();
+      }
+    }
+  }
+}
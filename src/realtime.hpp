@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+namespace sfx {
+  namespace io {
+
+    /**
+     * Real time execution of the calling thread, for the I/O thread of the
+     *  bridge : memory locked, pinned to one core, SCHED_FIFO, stack and
+     *  heap prefaulted so the hot path never waits on a page fault.
+     * Scheduling and affinity are inherited by threads created afterwards,
+     *  so enter() is called before the receive pipeline is started.
+     * Every step is attempted even if a former one failed, lacking
+     *  privileges typically leaves the process time shared but locked.
+     */
+    namespace realtime {
+
+      struct config {
+        int         cpu = -1;                /**< Core to pin to, -1 keeps the affinity */
+        int         priority = 50;           /**< SCHED_FIFO priority, 1 to 99 */
+        std::size_t stack = 512 * 1024;      /**< Stack bytes to prefault */
+        std::size_t heap = 4 * 1024 * 1024;  /**< Heap bytes to prefault and keep mapped */
+      };
+
+      /** Outcome of each step, errno of the failure or 0 **/
+      struct report {
+        int locked = -1;
+        int pinned = -1;     /**< 0 as well when no core is configured */
+        int scheduled = -1;
+        int prefaulted = -1;
+
+        explicit operator bool() const
+          { return 0 == locked && 0 == pinned && 0 == scheduled && 0 == prefaulted; }
+        /** One line summary, naming failed steps and why **/
+        std::string str() const;
+      };
+
+      report enter(const config& cfg);
+      /** Back to time sharing and pageable memory, for benchmarks **/
+      void leave();
+    }
+  }
+}
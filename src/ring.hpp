@@ -0,0 +1,142 @@
+#pragma once
+
+#include <span>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <cstddef>
+#include <algorithm>
+
+namespace sfx {
+  namespace io {
+
+    /**
+     * Fixed capacity single producer single consumer ring buffer.
+     * Storage is allocated once, at construction or reset, and elements
+     *  are exposed as contiguous spans so producer and consumer can work
+     *  in place. Capacity is rounded up to a power of two.
+     */
+    template <typename T>
+    class ring {
+    public:
+
+      /** Nested types **/
+      using element_type = T;
+
+      /** Ctors **/
+      explicit ring(std::size_t capacity = 0) { reset(capacity); }
+
+      ring(const ring&) = delete;
+      ring& operator= (const ring&) = delete;
+
+      /** Reallocate storage and drop content, not thread safe **/
+      void reset(std::size_t capacity)
+      {
+        std::size_t c = 1;
+        while (c < capacity) c <<= 1;
+        _capacity = capacity == 0 ? 0 : c;
+        _storage = _capacity == 0 ? nullptr : std::make_unique<T[]>(_capacity);
+        _head.store(0, std::memory_order_relaxed);
+        _tail.store(0, std::memory_order_relaxed);
+      }
+
+      /** Accessors **/
+      std::size_t capacity() const { return _capacity; }
+      std::size_t size() const
+      {
+        return _tail.load(std::memory_order_acquire)
+          - _head.load(std::memory_order_acquire);
+      }
+      bool empty() const { return size() == 0; }
+      bool full() const { return size() == _capacity; }
+
+      /** Producer side **/
+
+      /** Contiguous free space at the back, may be shorter than free space **/
+      std::span<T> writable()
+      {
+        if (_capacity == 0) return {};
+        std::size_t tail = _tail.load(std::memory_order_relaxed);
+        std::size_t head = _head.load(std::memory_order_acquire);
+        std::size_t offset = tail & (_capacity - 1);
+        std::size_t n = std::min(_capacity - (tail - head), _capacity - offset);
+        return {_storage.get() + offset, n};
+      }
+      /** Publish n elements written through writable() **/
+      void commit(std::size_t n)
+      {
+        _tail.store(_tail.load(std::memory_order_relaxed) + n,
+          std::memory_order_release);
+      }
+      /** Copy as many elements as possible, returns count copied **/
+      std::size_t write(std::span<const T> src)
+      {
+        std::size_t done = 0;
+        while (done < src.size())
+        {
+          auto dst = writable();
+          if (dst.empty()) break;
+          std::size_t n = std::min(dst.size(), src.size() - done);
+          std::copy_n(src.begin() + done, n, dst.begin());
+          commit(n);
+          done += n;
+        }
+        return done;
+      }
+      bool push(const T& t) { return 1 == write({&t, 1}); }
+
+      /** Consumer side **/
+
+      /** Contiguous readable elements at the front, may be shorter than size **/
+      std::span<const T> readable() const
+      {
+        if (_capacity == 0) return {};
+        std::size_t head = _head.load(std::memory_order_relaxed);
+        std::size_t tail = _tail.load(std::memory_order_acquire);
+        std::size_t offset = head & (_capacity - 1);
+        std::size_t n = std::min(tail - head, _capacity - offset);
+        return {_storage.get() + offset, n};
+      }
+      /** Every readable element, as two contiguous parts **/
+      std::pair<std::span<const T>, std::span<const T>> segments() const
+      {
+        if (_capacity == 0) return {};
+        std::size_t head = _head.load(std::memory_order_relaxed);
+        std::size_t tail = _tail.load(std::memory_order_acquire);
+        std::size_t offset = head & (_capacity - 1);
+        std::size_t n = std::min(tail - head, _capacity - offset);
+        return {
+          {_storage.get() + offset, n},
+          {_storage.get(), tail - head - n}};
+      }
+      /** Release n elements read through readable() **/
+      void consume(std::size_t n)
+      {
+        _head.store(_head.load(std::memory_order_relaxed) + n,
+          std::memory_order_release);
+      }
+      /** Copy as many elements as possible, returns count copied **/
+      std::size_t read(std::span<T> dst)
+      {
+        std::size_t done = 0;
+        while (done < dst.size())
+        {
+          auto src = readable();
+          if (src.empty()) break;
+          std::size_t n = std::min(src.size(), dst.size() - done);
+          std::copy_n(src.begin(), n, dst.begin() + done);
+          consume(n);
+          done += n;
+        }
+        return done;
+      }
+      bool pop(T& t) { return 1 == read({&t, 1}); }
+
+    private:
+      alignas(64) std::atomic<std::size_t> _head{0}; /**< Consumer position */
+      alignas(64) std::atomic<std::size_t> _tail{0}; /**< Producer position */
+      alignas(64) std::size_t              _capacity = 0;
+      std::unique_ptr<T[]>                 _storage;
+    };
+  }
+}
@@ -1,90 +1,11 @@
 #include "serial-io.hpp"
+#include "metrics.hpp"
 
-#include <stdio.h>    // Standard input/output definitions 
-#include <unistd.h>   // UNIX standard function definitions 
-#include <fcntl.h>    // File control definitions 
 #include <errno.h>    // Error number definitions 
-#include <termios.h>  // POSIX terminal control definitions 
-#include <string.h>   // String function definitions 
-#include <sys/ioctl.h>
+#include <sys/uio.h>
 
 #include <cassert>
-
-namespace {
-  // takes the string name of the serial port (e.g. "/dev/tty.usbserial","COM1")
-  // and a baud rate (bps) and connects to that port at that speed and 8N1.
-  // opens the port in fully raw mode so you can send binary data.
-  // returns valid fd, or -1 on error
-  int serialport_init(const char* serialport, int baud)
-  {
-      struct termios toptions;
-      int fd;
-      
-      //fd = open(serialport, O_RDWR | O_NOCTTY | O_NDELAY);
-      fd = open(serialport, O_RDWR | O_NONBLOCK );
-      
-      if (fd == -1)  {
-          perror("serialport_init: Unable to open port ");
-          return -1;
-      }
-      
-      //int iflags = TIOCM_DTR;
-      //ioctl(fd, TIOCMBIS, &iflags);     // turn on DTR
-      //ioctl(fd, TIOCMBIC, &iflags);    // turn off DTR
-
-      if (tcgetattr(fd, &toptions) < 0) {
-          perror("serialport_init: Couldn't get term attributes");
-          return -1;
-      }
-      speed_t brate = baud; // let you override switch below if needed
-      switch(baud) {
-      case 4800:   brate=B4800;   break;
-      case 9600:   brate=B9600;   break;
-  #ifdef B14400
-      case 14400:  brate=B14400;  break;
-  #endif
-      case 19200:  brate=B19200;  break;
-  #ifdef B28800
-      case 28800:  brate=B28800;  break;
-  #endif
-      case 38400:  brate=B38400;  break;
-      case 57600:  brate=B57600;  break;
-      case 115200: brate=B115200; break;
-      }
-      cfsetispeed(&toptions, brate);
-      cfsetospeed(&toptions, brate);
-
-      // 8N1
-      toptions.c_cflag &= ~PARENB;
-      toptions.c_cflag &= ~CSTOPB;
-      toptions.c_cflag &= ~CSIZE;
-      toptions.c_cflag |= CS8;
-      // no flow control
-      toptions.c_cflag &= ~CRTSCTS;
-
-      //toptions.c_cflag &= ~HUPCL; // disable hang-up-on-close to avoid reset
-
-      toptions.c_cflag |= CREAD | CLOCAL;  // turn on READ & ignore ctrl lines
-      toptions.c_iflag &= ~(IXON | IXOFF | IXANY); // turn off s/w flow ctrl
-
-      toptions.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG); // make raw
-      toptions.c_oflag &= ~OPOST; // make raw
-
-      // see: http://unixwiz.net/techtips/termios-vmin-vtime.html
-      toptions.c_cc[VMIN]  = 0;
-      toptions.c_cc[VTIME] = 0;
-      //toptions.c_cc[VTIME] = 20;
-      
-      tcsetattr(fd, TCSANOW, &toptions);
-      if( tcsetattr(fd, TCSAFLUSH, &toptions) < 0) {
-          perror("init_serialport: Couldn't set term attributes");
-          return -1;
-      }
-
-      return fd;
-  }
-
-}
+#include <algorithm>
 
 namespace sfx {
   namespace io {
@@ -92,33 +13,106 @@ namespace sfx {
     serial::result serial::begin(config cfg)
     {
       if (!cfg) return result::Failed;
-      auto h = handle::try_open(cfg);
-      if (!h.has_value()) return result::Failed;
-      _handle = std::make_unique<handle>(std::move(h.value()));
+      auto t = tty::try_open(cfg.port, cfg.baudrate, {cfg.vmin, cfg.vtime, cfg.low_latency, cfg.hangup});
+      if (!t) return result::Failed;
+      return begin(std::move(t), cfg);
+    }
+    serial::result serial::begin(std::unique_ptr<transport> t, config cfg)
+    {
+      if (!t) return result::Failed;
+      _transport = std::move(t);
       _cfg = cfg;
+      _rx.reset(cfg.rx_capacity);
+      _tx.reset(cfg.tx_capacity);
+      _stats = counters();
 
       assert(status::Active == state());
       return result::Ok;
     }
     void serial::end()
     {
-      _handle.reset();
+      _transport.reset();
       assert(status::Dead == state());
     }
 
+    void serial::instrument(metrics::registry& r, const std::string& prefix)
+    {
+      _probes.rx_bytes = &r.add_counter(prefix + ".rx.bytes");
+      _probes.rx_reads = &r.add_counter(prefix + ".rx.reads");
+      _probes.tx_bytes = &r.add_counter(prefix + ".tx.bytes");
+      _probes.tx_writes = &r.add_counter(prefix + ".tx.writes");
+      _probes.tx_truncated = &r.add_counter(prefix + ".tx.truncated");
+      _probes.tx_partial = &r.add_counter(prefix + ".tx.partial");
+      _probes.tx_queue = &r.add_gauge(prefix + ".tx.queue");
+    }
+
     std::pair<serial::result, ssize_t>
       serial::send(const std::vector<std::byte>& msg)
     {
       assert(status::Active == state());
-      ssize_t n = write(_handle->fd(), msg.data(), msg.size());
-      if (n < 0)
+      if (result::Ok != post(msg))
+        return {result::Truncated, 0};
+      auto [code, n] = transmit();
+      if (result::Failed == code)
         return {result::Failed, n};
-      else if (static_cast<size_t>(n) != msg.size())
-        return {result::Truncated, n};
       else
         return {result::Ok, 0};
     }
-    
+
+    serial::result serial::post(std::span<const std::byte> msg)
+    {
+      assert(status::Active == state());
+      if (_tx.capacity() - _tx.size() < msg.size())
+      {
+        _stats.rejected += 1;
+        if (_probes.tx_truncated)
+          _probes.tx_truncated->add();
+        return result::Truncated;
+      }
+      _tx.write(msg);
+      _stats.peak = std::max(_stats.peak, _tx.size());
+      if (_probes.tx_queue)
+        _probes.tx_queue->set(_tx.size());
+      return result::Ok;
+    }
+
+    std::pair<serial::result, ssize_t>
+      serial::transmit()
+    {
+      assert(status::Active == state());
+      auto [first, second] = _tx.segments();
+      if (first.empty())
+        return {result::Ok, 0};
+
+      iovec iov[2] = {
+        {const_cast<std::byte*>(first.data()), first.size()},
+        {const_cast<std::byte*>(second.data()), second.size()}};
+      ssize_t n = _transport->write(iov, second.empty() ? 1 : 2);
+      _stats.syscalls += 1;
+      if (_probes.tx_writes)
+        _probes.tx_writes->add();
+
+      if (n < 0)
+      {
+        if (errno != EWOULDBLOCK && errno != EAGAIN)
+          return {result::Failed, n};
+        if (_probes.tx_partial)
+          _probes.tx_partial->add();
+        return {result::Truncated, 0};
+      }
+
+      _tx.consume(n);
+      _stats.written += n;
+      if (_probes.tx_bytes)
+      {
+        _probes.tx_bytes->add(n);
+        _probes.tx_queue->set(_tx.size());
+        if (pending())
+          _probes.tx_partial->add();
+      }
+      return {pending() ? result::Truncated : result::Ok, n};
+    }
+
     std::pair<serial::result, std::vector<std::byte>>
       serial::receive(size_t hint /* = 16 */)
     {
@@ -128,7 +122,7 @@ namespace sfx {
 
       ssize_t n = 0;
       size_t written = 0;
-      while (0 < (n = read(_handle->fd(), buffer.data() + written, hint)))
+      while (0 < (n = _transport->read(std::span(buffer).subspan(written, hint))))
       {
         written += n;
         if (n != hint) break;
@@ -137,35 +131,70 @@ namespace sfx {
           buffer.resize(buffer.capacity() * 2);
       }
       buffer.resize(written);
+      if (_probes.rx_bytes)
+      {
+        _probes.rx_bytes->add(written);
+        _probes.rx_reads->add();
+      }
 
-      if (n == -1 && errno != EWOULDBLOCK && errno == EAGAIN)
+      if (n == -1 && errno != EWOULDBLOCK && errno != EAGAIN)
         return {result::Failed, buffer};
       else
         return {result::Ok, buffer};
     }
+
+    std::pair<serial::result, std::span<std::byte>>
+      serial::receive(std::span<std::byte> buffer)
+    {
+      assert(status::Active == state());
+      ssize_t n = _transport->read(buffer);
+      if (_probes.rx_bytes && 0 < n)
+      {
+        _probes.rx_bytes->add(n);
+        _probes.rx_reads->add();
+      }
+      if (n == -1 && errno != EWOULDBLOCK && errno != EAGAIN)
+        return {result::Failed, buffer.first(0)};
+      else
+        return {result::Ok, buffer.first(n < 0 ? 0 : n)};
+    }
+
+    std::pair<serial::result, std::size_t>
+      serial::receive_buffered()
+    {
+      assert(status::Active == state());
+      std::size_t total = 0;
+      /** loop twice at most, when free space wraps around the ring **/
+      for (auto dst = _rx.writable(); !dst.empty(); dst = _rx.writable())
+      {
+        auto [code, got] = receive(dst);
+        _rx.commit(got.size());
+        total += got.size();
+        if (result::Ok != code)
+          return {code, total};
+        if (got.size() != dst.size())
+          break;
+      }
+      return {result::Ok, total};
+    }
     
     serial::result serial::flush()
     {
       assert(status::Active == state());
-      if (-1 == tcflush(_handle->fd(), TCIOFLUSH))
+      if (!_transport->flush())
         return result::Failed;
       else
         return result::Ok;
     }
 
-    void serial::handle::terminate()
+    serial::result serial::set_baudrate(int baudrate)
     {
-      if (bool(*this))
-        close(_fd);
-    }
-    std::optional<serial::handle>
-      serial::handle::try_open(config cfg)
-    {
-      int fd = serialport_init(cfg.port.c_str(), cfg.baudrate);
-      if (fd <= 0)
-        return std::nullopt;
-      else
-        return std::make_optional<handle>(fd);
+      assert(status::Active == state());
+      if (!_transport->set_baudrate(baudrate))
+        return result::Failed;
+      _cfg.baudrate = baudrate;
+      return result::Ok;
     }
+
   }
 }
\ No newline at end of file
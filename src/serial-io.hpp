@@ -3,19 +3,52 @@
 #include <string>
 #include <vector>
 #include <utility>
-#include <optional>
 #include <memory>
+#include <span>
+#include <chrono>
+
+#include "ring.hpp"
+#include "transport.hpp"
 
 namespace sfx {
   namespace io {
 
+    namespace metrics {
+      class counter;
+      class gauge;
+      class registry;
+    }
+
     class serial {
     public:
 
       /** Nested types **/
       struct config {
         std::string port;
-        int         baudrate;
+        int         baudrate = 0;
+        std::size_t rx_capacity = 256; /**< Size of the receive ring */
+        std::size_t tx_capacity = 1024; /**< Size of the outbound queue */
+
+        /**
+         * Receive policy, trading syscalls against latency.
+         * The port polls readable once vmin bytes wait, or as soon as one
+         *  does when vmin is 0 or vtime is set : a vmin above the shortest
+         *  message may hold the last one until more traffic comes.
+         * Reader threads, see io::pipeline, also wait coalesce after each
+         *  wakeup so a burst is read in one call. Ignored on the reactor
+         *  thread, which must not sleep.
+         */
+        uint8_t                   vmin = 0;
+        uint8_t                   vtime = 0;          /**< In deciseconds */
+        bool                      low_latency = true; /**< Driver flag, when supported */
+        std::chrono::microseconds coalesce{0};
+
+        /**
+         * HUPCL, DTR drops when the port is closed. Most Arduino boards
+         *  reset when DTR rises again, that is on the next open : clear
+         *  it so reconnecting does not reboot the pedalboard.
+         */
+        bool hangup = true;
 
         explicit operator bool() const
           { return baudrate != 0 && port.size() != 0; }
@@ -24,64 +57,111 @@ namespace sfx {
       enum class status { Dead, Active };
       enum class result { Ok, Failed, Truncated };
 
+      /** Outbound queue statistics **/
+      struct counters {
+        std::size_t syscalls = 0; /**< write calls issued */
+        std::size_t written  = 0; /**< bytes actually written */
+        std::size_t rejected = 0; /**< messages refused by a full queue */
+        std::size_t peak     = 0; /**< highest queue depth seen, in bytes */
+
+        double bytes_per_syscall() const
+          { return syscalls == 0 ? 0. : double(written) / syscalls; }
+      };
+
       /** Accessors **/
       config cfg() const { return _cfg; }
       status state() const
       { 
-        return bool(_cfg) && bool(_handle)
+        return bool(_transport)
           ? status::Active
           : status::Dead
           ;
       }
+      /** File descriptor of the opened port, -1 if dead **/
+      int fd() const
+        { return bool(_transport) ? _transport->fd() : -1; }
+      /** Underlying link, nullptr if dead **/
+      const transport* link() const { return _transport.get(); }
+
+      /** Count of bytes waiting in the outbound queue **/
+      std::size_t queue_depth() const { return _tx.size(); }
+      bool pending() const { return !_tx.empty(); }
+      const counters& stats() const { return _stats; }
 
       /** Methods **/
+      /** Open cfg.port as a termios serial device **/
       result begin(config cfg);
+      /** Talk through an already opened transport, cfg port is ignored **/
+      result begin(std::unique_ptr<transport> t, config cfg);
+      result begin(std::unique_ptr<transport> t)
+        { return begin(std::move(t), config()); }
       void end();
 
+      /**
+       * Publish traffic figures as <prefix>.rx.* and <prefix>.tx.*.
+       * Receive ones are updated by the receiving thread, transmit ones by
+       *  the posting thread, each keeps a single writer.
+       */
+      void instrument(metrics::registry& r, const std::string& prefix = "serial");
+
+      /** Queue msg then try to write the whole queue at once **/
       std::pair<result, ssize_t>
       send(const std::vector<std::byte>& msg);
+
+      /**
+       * Append msg to the outbound queue without writing it.
+       * Returns Truncated, and queues nothing, if msg does not fit.
+       */
+      result post(std::span<const std::byte> msg);
+      /**
+       * Write as much of the outbound queue as possible in one syscall.
+       * Returns Truncated with the count written if bytes remain queued,
+       *  call again once the port is writable.
+       */
+      std::pair<result, ssize_t>
+      transmit();
       
       std::pair<result, std::vector<std::byte>>
       receive(size_t hint = 16);
+
+      /** Read available bytes into buffer, returns the filled part **/
+      std::pair<result, std::span<std::byte>>
+      receive(std::span<std::byte> buffer);
+
+      /** Read available bytes into the receive ring, returns count read **/
+      std::pair<result, std::size_t>
+      receive_buffered();
+      /** Contiguous view over buffered bytes, call again after consume **/
+      std::span<const std::byte> buffered() const
+        { return _rx.readable(); }
+      /** Release n bytes from the front of the receive ring **/
+      void consume(std::size_t n)
+        { _rx.consume(n); }
       
       result flush();
 
-    private:
-      
-      class handle {
-      public:
-        /** C calls wrappers **/
-        static std::optional<handle>
-          try_open(config cfg);
-
-        void terminate();
-
-        /** Ctors **/
-        handle(const handle&) = delete;
-        handle& operator= (const handle&) = delete;
-        
-        handle(handle&& s)
-          : _fd{s._fd}
-          { s._fd = 0; }
-        handle& operator= (handle&& s)
-          { terminate(); _fd = s._fd; return *this; }
-
-        ~handle() { terminate(); }
-
-        /** Accessors **/
-        int fd() const
-          { return _fd; }
+      /** Switch link speed once bytes already written are sent **/
+      result set_baudrate(int baudrate);
 
-        explicit operator bool() const
-          { return _fd != 0; }
+    private:
 
-      private:
-        handle(int fd) : _fd{fd} {} /**< Prevent invalid handle **/
-        int _fd;                    /**< File descriptor **/
+      /** Unset until instrument() **/
+      struct probes {
+        metrics::counter* rx_bytes = nullptr;
+        metrics::counter* rx_reads = nullptr;
+        metrics::counter* tx_bytes = nullptr;
+        metrics::counter* tx_writes = nullptr;
+        metrics::counter* tx_truncated = nullptr; /**< post() refused, queue full */
+        metrics::counter* tx_partial = nullptr;   /**< transmit() left bytes queued */
+        metrics::gauge*   tx_queue = nullptr;
       };
 
-      config                  _cfg;
-      std::unique_ptr<handle> _handle;
+      config                     _cfg;
+      std::unique_ptr<transport> _transport;
+      ring<std::byte>            _rx;   /**< Preallocated receive storage */
+      ring<std::byte>            _tx;   /**< Outbound queue */
+      counters                   _stats;
+      probes                     _probes;
     };
   }
 }
\ No newline at end of file
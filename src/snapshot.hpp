@@ -0,0 +1,100 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+namespace sfx {
+  namespace io {
+
+    /**
+     * Latest value of T, published by one writer thread and read by any
+     *  number of reader threads without locks.
+     * Two slots are used in turn, each guarded by a sequence counter : the
+     *  writer fills the slot readers are not pointed at, then flips the
+     *  pointer, so it never waits. A reader only retries when the writer
+     *  came back to its slot during the copy, that is after two publishes.
+     * Slots are stored as relaxed atomic words, so copies racing with the
+     *  writer are well defined and simply discarded.
+     */
+    template <typename T>
+    class snapshot {
+    public:
+      static_assert(std::is_trivially_copyable_v<T>, "snapshots are copied as raw words");
+
+      /** Nested types **/
+      using value_type = T;
+
+      /** Ctors **/
+      explicit snapshot(const T& init = T()) { publish(init); }
+
+      snapshot(const snapshot&) = delete;
+      snapshot& operator= (const snapshot&) = delete;
+
+      /** Writer side, a single thread **/
+      void publish(const T& value)
+      {
+        word_type words[words_count] = {};
+        std::memcpy(words, &value, sizeof(T));
+
+        std::size_t next = _published.load(std::memory_order_relaxed) ^ 1;
+        slot& s = _slots[next];
+        uint64_t seq = s.seq.load(std::memory_order_relaxed);
+        s.seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (std::size_t i = 0; i < words_count; ++i)
+          s.data[i].store(words[i], std::memory_order_relaxed);
+        s.seq.store(seq + 2, std::memory_order_release);
+        _published.store(next, std::memory_order_release);
+        _version.fetch_add(1, std::memory_order_release);
+      }
+
+      /** Reader side, any thread **/
+
+      /** Copy of the latest value, returns the count of retries it took **/
+      std::size_t read(T& value) const
+      {
+        word_type words[words_count];
+        for (std::size_t retries = 0;; ++retries)
+        {
+          const slot& s = _slots[_published.load(std::memory_order_acquire)];
+          uint64_t seq = s.seq.load(std::memory_order_acquire);
+          if (seq & 1)
+            continue;
+          for (std::size_t i = 0; i < words_count; ++i)
+            words[i] = s.data[i].load(std::memory_order_relaxed);
+          std::atomic_thread_fence(std::memory_order_acquire);
+          if (seq != s.seq.load(std::memory_order_relaxed))
+            continue;
+          std::memcpy(&value, words, sizeof(T));
+          return retries;
+        }
+      }
+      T read() const
+      {
+        T value;
+        read(value);
+        return value;
+      }
+
+      /** Count of publishes, readers may poll it to skip unchanged states **/
+      uint64_t version() const { return _version.load(std::memory_order_acquire); }
+
+    private:
+      using word_type = uint64_t;
+      static constexpr std::size_t words_count = (sizeof(T) + sizeof(word_type) - 1) / sizeof(word_type);
+
+      struct alignas(64) slot {
+        std::atomic<uint64_t>                             seq{0}; /**< odd while written */
+        std::array<std::atomic<word_type>, words_count>   data{};
+      };
+
+      slot                                   _slots[2];
+      alignas(64) std::atomic<std::size_t>   _published{1}; /**< slot readers copy */
+      std::atomic<uint64_t>                  _version{0};
+    };
+  }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "midi.hpp"
+#include "datastore.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+
+namespace sfx {
+    namespace datastore {
+
+        /**
+         * Host view of the pedalboard, tracked by the bridge from the board
+         *  traffic and published as a whole to reader threads, see
+         *  io::snapshot. Kept trivially copyable, parameters included as a
+         *  raw copy of the store arena.
+         */
+        struct board {
+            static constexpr std::size_t channels_count = 8;
+            static constexpr std::size_t exprs_count = 2;
+            static constexpr std::size_t params_capacity = 256;
+
+            /** Firmware defaults, see datastore::config in the sketch **/
+            static constexpr uint8_t footswitch_cc = 0x04;
+            static constexpr uint8_t expression_cc = 0x0B;
+
+            uint64_t batch = 0;      /**< parsed batches published so far */
+            uint16_t switches = 0;   /**< bit i set while switch i is pressed */
+            uint16_t leds_on = 0;    /**< bit i set while LED i is on */
+            uint16_t leds_blink = 0; /**< bit i set while LED i blinks */
+            std::array<uint16_t, exprs_count> exprs{}; /**< 14 bits values */
+
+            uint32_t params_size = 0;
+            std::array<std::byte, params_capacity> params{};
+
+            /** Track a message from the board, false when it changes nothing **/
+            bool update(const midi::message& msg)
+            {
+                if (msg.is_sysex() || msg.size != 2)
+                    return false;
+                uint8_t channel = msg.channel(), cc = uint8_t(msg.data[0]), value = uint8_t(msg.data[1]);
+                if (cc == footswitch_cc && channel < channels_count)
+                {
+                    uint16_t s = value ? switches | (1u << channel) : switches & ~(1u << channel);
+                    return std::exchange(switches, s) != s;
+                }
+                if ((cc == expression_cc || cc == expression_cc + 0x20) && channel < exprs_count)
+                {
+                    /* MSB resets the LSB, as MIDI 14 bits controllers do */
+                    uint16_t v = cc == expression_cc ? uint16_t(value << 7) : uint16_t((exprs[channel] & ~0x7F) | value);
+                    return std::exchange(exprs[channel], v) != v;
+                }
+                return false;
+            }
+
+            /** Copy the values of a parameter store, false if they do not fit **/
+            bool copy_params(const store& s)
+            {
+                auto arena = s.arena();
+                if (params_capacity < arena.size())
+                    return false;
+                std::copy(arena.begin(), arena.end(), params.begin());
+                params_size = uint32_t(arena.size());
+                return true;
+            }
+            template <typename T> T param(handle<T> h) const
+            {
+                T value;
+                std::memcpy(&value, params.data() + h.offset, sizeof(T));
+                return value;
+            }
+        };
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "parser.hpp"
+
+#include <array>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+
+namespace sfx {
+namespace io {
+
+/**
+ * Parser whose protocol is fixed at compile time.
+ * Each Rule is a type providing
+ *  static constexpr bool accepts(std::byte status)
+ *  static result parse(raw_citerator begin, raw_citerator end)
+ * The status byte is mapped to its rule through a flat 256 entries table
+ *  built at compile time, validators are called directly and can be inlined.
+ * First rule accepting a status byte wins.
+ */
+template <typename Object, typename... Rules>
+class static_parser : public basic_parser<Object, static_parser<Object, Rules...>> {
+public:
+
+    using base = basic_parser<Object, static_parser<Object, Rules...>>;
+    using typename base::result;
+    using typename base::raw_citerator;
+
+    static_assert(sizeof...(Rules) < 0xFF, "Too many rules");
+
+    /** Ctors **/
+    explicit static_parser(std::size_t hint = sizeof(Object))
+        : base(hint)
+        {}
+
+private:
+    friend base;
+
+    /** Status byte to 1 + rule index, 0 for rejected bytes **/
+    static constexpr std::array<uint8_t, 256> table = []()
+    {
+        std::array<uint8_t, 256> t{};
+        for (std::size_t b = 0; b < t.size(); ++b)
+        {
+            uint8_t i = 0;
+            ((t[b] == 0 && Rules::accepts(std::byte(b))
+                ? (t[b] = i + 1, ++i) : ++i), ...);
+        }
+        return t;
+    }();
+
+    static constexpr std::size_t rules_count() { return sizeof...(Rules); }
+
+    template <std::size_t... Is>
+    static std::optional<result> invoke(
+        uint8_t rule, raw_citerator begin, raw_citerator end,
+        std::index_sequence<Is...>)
+    {
+        std::optional<result> res;
+        ((rule == Is + 1 ? (res = Rules::parse(begin, end), true) : false) || ...);
+        return res;
+    }
+
+    std::optional<result>
+        dispatch(raw_citerator begin, raw_citerator end) const
+    {
+        return invoke(
+            table[static_cast<uint8_t>(*begin)], begin, end,
+            std::index_sequence_for<Rules...>());
+    }
+};
+
+} /**< namespace io **/
+} /**< namespace sfx **/
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "midi.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+namespace sfx {
+namespace midi {
+
+/** Host clock timestamps are compared with, in microseconds **/
+inline int64_t host_micros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Board clock estimate, from ping / pong round trips.
+ * The board time is assumed to be taken half way through the round trip,
+ *  so the error on the offset is bounded by half the round trip minus the
+ *  link delay. Queued traffic only lengthens round trips, hence the offset
+ *  comes from the fastest one among the last `window` exchanges : recent
+ *  enough to follow the drift of the board oscillator.
+ */
+class clock_sync {
+public:
+    static constexpr std::size_t window = 8;
+
+    /** Sequence number of the next ping, sent at host time now **/
+    uint8_t ping(int64_t now)
+    {
+        uint8_t seq = _next;
+        _next = (_next + 1) & 0x7F;
+        _sent[seq] = now;
+        return seq;
+    }
+
+    /** Pong received at host time now, false when it matches no ping **/
+    bool pong(const midi::pong& p, int64_t now)
+    {
+        int64_t sent = _sent[p.sequence & 0x7F];
+        if (sent < 0 || now < sent)
+            return false;
+        _sent[p.sequence & 0x7F] = -1;
+        _samples[_count++ % window] = {now - sent, sent + (now - sent) / 2 - int64_t(p.time)};
+        auto best = std::min_element(_samples.begin(), _samples.begin() + std::min(_count, window),
+            [](const sample& a, const sample& b) { return a.rtt < b.rtt; });
+        _rtt = best->rtt;
+        _offset = best->offset;
+        return true;
+    }
+
+    bool synced() const { return _count != 0; }
+
+    /** Round trip of the best recent exchange, in us **/
+    int64_t round_trip() const { return _rtt; }
+
+    /** Delay between a board timestamp and host time now, in us **/
+    int64_t since(uint32_t board_time, int64_t now) const
+    {
+        /* board time is known modulo 2^28, pick the closest occurrence */
+        constexpr int64_t period = int64_t(sysex::time_mask) + 1;
+        int64_t elapsed = (now - _offset - int64_t(board_time)) & sysex::time_mask;
+        return elapsed < period / 2 ? elapsed : elapsed - period;
+    }
+
+private:
+    struct sample {
+        int64_t rtt;
+        int64_t offset; /**< host time minus board time */
+    };
+
+    std::array<int64_t, 128>   _sent = filled(-1); /**< send time per sequence, -1 when none */
+    std::array<sample, window> _samples{};
+    std::size_t                _count = 0;
+    uint8_t                    _next = 0;
+    int64_t                    _rtt = 0;
+    int64_t                    _offset = 0;
+
+    static std::array<int64_t, 128> filled(int64_t v)
+    {
+        std::array<int64_t, 128> a;
+        a.fill(v);
+        return a;
+    }
+};
+
+/**
+ * Latency distribution with bounded memory.
+ * Buckets are log linear : each power of two is split in `steps` buckets,
+ *  so values are kept with a relative error under 1/steps.
+ */
+class histogram {
+public:
+    static constexpr unsigned step_bits = 3;
+    static constexpr unsigned steps = 1 << step_bits;
+    static constexpr unsigned magnitudes = 32;
+    static constexpr std::size_t buckets_count = magnitudes * steps;
+
+    void record(int64_t value)
+    {
+        if (value < 0)
+        {
+            _negatives += 1;
+            value = 0;
+        }
+        _buckets[bucket_of(uint64_t(value))] += 1;
+        _count += 1;
+        _max = std::max(_max, value);
+    }
+
+    std::size_t count() const { return _count; }
+    int64_t max() const { return _max; }
+    /** Samples below zero, recorded as 0, a sign of a stale clock estimate **/
+    std::size_t negatives() const { return _negatives; }
+
+    /** Upper bound of the bucket holding quantile q **/
+    int64_t quantile(double q) const
+    {
+        if (_count == 0)
+            return 0;
+        std::size_t rank = std::size_t(q * (_count - 1)) + 1, seen = 0;
+        for (std::size_t i = 0; i < _buckets.size(); ++i)
+            if (rank <= (seen += _buckets[i]))
+                return std::min(upper_bound(i), _max);
+        return _max;
+    }
+
+    void clear() { *this = histogram(); }
+
+    /** Bucket layout, shared with histograms kept elsewhere **/
+    static std::size_t bucket_of(uint64_t v)
+    {
+        if (v < steps)
+            return v;
+        unsigned m = 63 - __builtin_clzll(v);                /* v in [2^m, 2^(m+1)) */
+        unsigned sub = (v >> (m - step_bits)) & (steps - 1); /* next bits */
+        return std::min<std::size_t>((m - step_bits + 1) * steps + sub, buckets_count - 1);
+    }
+    static int64_t upper_bound(std::size_t i)
+    {
+        if (i < steps)
+            return i;
+        unsigned m = i / steps + step_bits - 1, sub = i % steps;
+        return (int64_t(steps + sub + 1) << (m - step_bits)) - 1;
+    }
+
+private:
+    std::array<std::size_t, buckets_count> _buckets{};
+    std::size_t _count = 0;
+    std::size_t _negatives = 0;
+    int64_t     _max = 0;
+};
+
+}
+}
@@ -0,0 +1,213 @@
+#include "transport.hpp"
+#include "linux-tty.hpp"
+
+#include <stdio.h>    // Standard input/output definitions 
+#include <stdlib.h>   // Pseudo terminal functions
+#include <unistd.h>   // UNIX standard function definitions 
+#include <fcntl.h>    // File control definitions 
+#include <errno.h>    // Error number definitions 
+#include <termios.h>  // POSIX terminal control definitions 
+#include <string.h>   // String function definitions 
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+namespace {
+  // maps a baud rate (bps) to its termios constant, false if there is none
+  bool baud_constant(int baud, speed_t& brate)
+  {
+      switch(baud) {
+      case 4800:    brate=B4800;    return true;
+      case 9600:    brate=B9600;    return true;
+  #ifdef B14400
+      case 14400:   brate=B14400;   return true;
+  #endif
+      case 19200:   brate=B19200;   return true;
+  #ifdef B28800
+      case 28800:   brate=B28800;   return true;
+  #endif
+      case 38400:   brate=B38400;   return true;
+      case 57600:   brate=B57600;   return true;
+      case 115200:  brate=B115200;  return true;
+  #ifdef B230400
+      case 230400:  brate=B230400;  return true;
+  #endif
+  #ifdef B460800
+      case 460800:  brate=B460800;  return true;
+  #endif
+  #ifdef B500000
+      case 500000:  brate=B500000;  return true;
+  #endif
+  #ifdef B921600
+      case 921600:  brate=B921600;  return true;
+  #endif
+  #ifdef B1000000
+      case 1000000: brate=B1000000; return true;
+  #endif
+  #ifdef B2000000
+      case 2000000: brate=B2000000; return true;
+  #endif
+      }
+      return false;
+  }
+
+  // takes the string name of the serial port (e.g. "/dev/tty.usbserial","COM1")
+  // and a baud rate (bps) and connects to that port at that speed and 8N1.
+  // opens the port in fully raw mode so you can send binary data.
+  // vmin and vtime are applied as is, the fd being non blocking they only
+  // tell when it polls readable : once vmin bytes wait if vtime is 0.
+  // returns valid fd, or -1 on error
+  int serialport_init(const char* serialport, int baud, cc_t vmin, cc_t vtime, bool hupcl)
+  {
+      struct termios toptions;
+      int fd;
+      
+      //fd = open(serialport, O_RDWR | O_NOCTTY | O_NDELAY);
+      fd = open(serialport, O_RDWR | O_NONBLOCK );
+      
+      if (fd == -1)  {
+          perror("serialport_init: Unable to open port ");
+          return -1;
+      }
+      
+      //int iflags = TIOCM_DTR;
+      //ioctl(fd, TIOCMBIS, &iflags);     // turn on DTR
+      //ioctl(fd, TIOCMBIC, &iflags);    // turn off DTR
+
+      if (tcgetattr(fd, &toptions) < 0) {
+          perror("serialport_init: Couldn't get term attributes");
+          close(fd);
+          return -1;
+      }
+      // rates without constant are set through termios2 once configured
+      speed_t brate = B38400;
+      bool custom = !baud_constant(baud, brate);
+      cfsetispeed(&toptions, brate);
+      cfsetospeed(&toptions, brate);
+
+      // 8N1
+      toptions.c_cflag &= ~PARENB;
+      toptions.c_cflag &= ~CSTOPB;
+      toptions.c_cflag &= ~CSIZE;
+      toptions.c_cflag |= CS8;
+      // no flow control
+      toptions.c_cflag &= ~CRTSCTS;
+
+      if (!hupcl)
+          toptions.c_cflag &= ~HUPCL; // disable hang-up-on-close to avoid reset
+
+      toptions.c_cflag |= CREAD | CLOCAL;  // turn on READ & ignore ctrl lines
+      toptions.c_iflag &= ~(IXON | IXOFF | IXANY); // turn off s/w flow ctrl
+      toptions.c_iflag &= ~(INLCR | IGNCR | ICRNL | ISTRIP | PARMRK); // binary, 0x0D is data
+
+      toptions.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG | IEXTEN); // make raw
+      toptions.c_oflag &= ~OPOST; // make raw
+
+      // see: http://unixwiz.net/techtips/termios-vmin-vtime.html
+      toptions.c_cc[VMIN]  = vmin;
+      toptions.c_cc[VTIME] = vtime;
+      
+      tcsetattr(fd, TCSANOW, &toptions);
+      if( tcsetattr(fd, TCSAFLUSH, &toptions) < 0) {
+          perror("init_serialport: Couldn't set term attributes");
+          close(fd);
+          return -1;
+      }
+      if (custom && !sfx::io::linux_tty::set_baudrate(fd, baud, false)) {
+          perror("init_serialport: Unsupported baudrate");
+          close(fd);
+          return -1;
+      }
+
+      return fd;
+  }
+
+}
+
+namespace sfx {
+  namespace io {
+
+    transport::~transport()
+    {
+      if (0 <= _fd)
+        close(_fd);
+    }
+    ssize_t transport::read(std::span<std::byte> buffer)
+    {
+      return ::read(_fd, buffer.data(), buffer.size());
+    }
+    ssize_t transport::write(const iovec* iov, int count)
+    {
+      return ::writev(_fd, iov, count);
+    }
+    bool transport::flush()
+    {
+      return -1 != tcflush(_fd, TCIOFLUSH);
+    }
+
+    std::unique_ptr<tty>
+      tty::try_open(const std::string& port, int baudrate, const settings& s)
+    {
+      int fd = serialport_init(port.c_str(), baudrate, s.vmin, s.vtime, s.hangup);
+      if (fd < 0)
+        return nullptr;
+      /* usb adapters and ptys often lack it, the port is usable anyway */
+      bool low_latency = s.low_latency && linux_tty::set_low_latency(fd);
+      return std::unique_ptr<tty>(new tty(fd, port, low_latency));
+    }
+    bool tty::set_baudrate(int baudrate)
+    {
+      termios toptions;
+      speed_t brate;
+      if (!baud_constant(baudrate, brate))
+        return linux_tty::set_baudrate(_fd, baudrate, true);
+      if (tcgetattr(_fd, &toptions) < 0)
+        return false;
+      cfsetispeed(&toptions, brate);
+      cfsetospeed(&toptions, brate);
+      /* let bytes already written go out at the former rate */
+      return -1 != tcsetattr(_fd, TCSADRAIN, &toptions);
+    }
+
+    std::unique_ptr<pty> pty::try_open()
+    {
+      int master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+      if (master < 0)
+        return nullptr;
+      if (grantpt(master) < 0 || unlockpt(master) < 0)
+      {
+        close(master);
+        return nullptr;
+      }
+      std::string peer = ptsname(master);
+
+      /** keep the slave open and raw, no echo nor line buffering **/
+      int slave = open(peer.c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+      termios toptions;
+      if (slave < 0 || tcgetattr(slave, &toptions) < 0)
+      {
+        if (0 <= slave) close(slave);
+        close(master);
+        return nullptr;
+      }
+      cfmakeraw(&toptions);
+      tcsetattr(slave, TCSANOW, &toptions);
+
+      return std::unique_ptr<pty>(new pty(master, slave, peer));
+    }
+    pty::~pty()
+    {
+      close(_slave);
+    }
+
+    std::pair<std::unique_ptr<pipe>, std::unique_ptr<pipe>>
+      pipe::try_open()
+    {
+      int fds[2];
+      if (-1 == socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds))
+        return {nullptr, nullptr};
+      return {
+        std::unique_ptr<pipe>(new pipe(fds[0])),
+        std::unique_ptr<pipe>(new pipe(fds[1]))};
+    }
+  }
+}
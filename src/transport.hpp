@@ -0,0 +1,118 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <memory>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+#include <sys/uio.h>
+#include <sys/types.h>
+
+namespace sfx {
+  namespace io {
+
+    /**
+     * Byte stream io::serial talks through.
+     * Every transport is backed by a non blocking file descriptor so it
+     *  can be watched by the reactor.
+     */
+    class transport {
+    public:
+
+      /** Ctors **/
+      transport(const transport&) = delete;
+      transport& operator= (const transport&) = delete;
+
+      virtual ~transport();
+
+      /** Accessors **/
+      int fd() const { return _fd; }
+      /** Human readable description of the link **/
+      virtual std::string name() const = 0;
+
+      /** Methods, same semantic as read(2) and writev(2) **/
+      virtual ssize_t read(std::span<std::byte> buffer);
+      virtual ssize_t write(const iovec* iov, int count);
+      /** Discard data not yet transmitted or read, false on failure **/
+      virtual bool flush();
+      /** Change link speed, meaningless for virtual links **/
+      virtual bool set_baudrate(int) { return true; }
+
+    protected:
+      explicit transport(int fd) : _fd{fd} {}
+      int _fd; /**< File descriptor, owned */
+    };
+
+    /**
+     * Serial device configured through termios.
+     * Any baudrate is accepted, rates without a Bxxx constant are set
+     *  through termios2 where the driver supports it.
+     */
+    class tty : public transport {
+    public:
+
+      /** Line discipline tuning, see serial::config **/
+      struct settings {
+        uint8_t vmin = 0;           /**< VMIN, bytes a wakeup waits for when vtime is 0 */
+        uint8_t vtime = 0;          /**< VTIME, in deciseconds */
+        bool    low_latency = true; /**< Request ASYNC_LOW_LATENCY */
+        bool    hangup = true;      /**< HUPCL, drop DTR on close */
+      };
+
+      static std::unique_ptr<tty>
+        try_open(const std::string& port, int baudrate, const settings& s);
+      static std::unique_ptr<tty>
+        try_open(const std::string& port, int baudrate)
+        { return try_open(port, baudrate, settings()); }
+
+      std::string name() const override { return _port; }
+      bool set_baudrate(int baudrate) override;
+
+      /** True if the driver accepted the low latency flag **/
+      bool low_latency() const { return _low_latency; }
+
+    private:
+      tty(int fd, std::string port, bool low_latency)
+        : transport(fd), _port(std::move(port)), _low_latency(low_latency) {}
+      std::string _port;
+      bool        _low_latency;
+    };
+
+    /**
+     * Master side of a pseudo terminal pair.
+     * The slave is kept open in raw mode, so a peer process can open it
+     *  as a regular serial port.
+     */
+    class pty : public transport {
+    public:
+      static std::unique_ptr<pty> try_open();
+
+      ~pty() override;
+
+      std::string name() const override { return "pty:" + _peer; }
+      /** Path of the slave device **/
+      const std::string& peer() const { return _peer; }
+
+    private:
+      pty(int fd, int slave, std::string peer)
+        : transport(fd), _slave(slave), _peer(std::move(peer)) {}
+      int         _slave;
+      std::string _peer;
+    };
+
+    /** In memory stream, both ends live in the same process **/
+    class pipe : public transport {
+    public:
+      static std::pair<std::unique_ptr<pipe>, std::unique_ptr<pipe>>
+        try_open();
+
+      std::string name() const override { return "pipe"; }
+      bool flush() override { return true; }
+
+    private:
+      explicit pipe(int fd) : transport(fd) {}
+    };
+  }
+}
@@ -0,0 +1,356 @@
+/**
+ * Pedalboard firmware emulator.
+ *
+ * Plays the board side of the link so the bridge can be load tested
+ *  without hardware. Traffic is either synthetic, footswitch toggles and
+ *  expression sweeps as push_changes() emits them, or replayed from a raw
+ *  capture of the serial link or one written by the bridge. Host to board
+ *  bytes are read and dropped, except that pings, presentation and link
+ *  speed requests are answered ; speed changes are only acknowledged, a
+ *  pty has no line rate.
+ *
+ * By default a pty pair is created and the slave path printed, the bridge
+ *  is then started on it : 5FX-Pedalboard <slave> 115200
+ */
+#include "serial-io.hpp"
+#include "capture.hpp"
+#include "transport.hpp"
+#include "reactor.hpp"
+#include "midi.hpp"
+#include "timing.hpp"
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+
+#include <sys/epoll.h>
+
+namespace {
+
+void usage()
+{
+    std::cout << "5FX-Emulator [--port path] [--rate msgs/s] [--count n]"
+                 " [--exprs ratio] [--replay file] [--delay ms] [--events]"
+                 " [--name board]" << std::endl;
+}
+
+struct options {
+    std::string port;           /**< Serial device, empty to create a pty */
+    double      rate = 1000;    /**< Messages per second */
+    std::size_t count = 0;      /**< Messages to send, 0 for no limit */
+    double      exprs = 0.5;    /**< Ratio of expression updates */
+    std::string replay;         /**< Raw capture to replay */
+    int         delay = 0;      /**< Wait before sending, in ms */
+    bool        events = false; /**< Add timestamped event records */
+    std::string name = "5FX-Pedalboard:001"; /**< Sent in the presentation */
+};
+
+bool parse_options(int argc, char *const argv[], options& opts)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        auto arg = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+        const char* v = nullptr;
+        if (0 == strcmp(argv[i], "--port") && (v = arg()))
+            opts.port = v;
+        else if (0 == strcmp(argv[i], "--rate") && (v = arg()))
+            opts.rate = std::atof(v);
+        else if (0 == strcmp(argv[i], "--count") && (v = arg()))
+            opts.count = std::atol(v);
+        else if (0 == strcmp(argv[i], "--exprs") && (v = arg()))
+            opts.exprs = std::atof(v);
+        else if (0 == strcmp(argv[i], "--replay") && (v = arg()))
+            opts.replay = v;
+        else if (0 == strcmp(argv[i], "--delay") && (v = arg()))
+            opts.delay = std::atoi(v);
+        else if (0 == strcmp(argv[i], "--events"))
+            opts.events = true;
+        else if (0 == strcmp(argv[i], "--name") && (v = arg()))
+            opts.name = v;
+        else
+            return false;
+    }
+    return 0 < opts.rate;
+}
+
+/** Board clock, micros() of the emulated board **/
+uint32_t board_time()
+{
+    return uint32_t(sfx::midi::host_micros()) & sysex::time_mask;
+}
+
+/** Synthetic traffic, same messages as datastore::global::push_changes() **/
+class synthetic {
+public:
+    synthetic(double exprs, bool events) : _exprs(exprs), _events(events) {}
+
+    std::size_t operator() (std::vector<std::byte>& out)
+    {
+        if (std::uniform_real_distribution<>()(_rng) < _exprs)
+        {
+            uint8_t id = _rng() % 2;
+            _sweep[id] = (_sweep[id] + 7) & 0x3FF;
+            uint16_t val16 = _sweep[id] << (14 - 10);
+            push(out, {0xC0 | id, 0x0B, (val16 >> 7) & 0x7F});
+            push(out, {0xC0 | id, 0x0B + 0x20, val16 & 0x7F});
+            if (_events)
+                event(out, sysex::Expression, id, _sweep[id] << 2);
+        }
+        else
+        {
+            uint8_t id = _rng() % 8;
+            _switches ^= 1 << id;
+            push(out, {0xC0 | id, 0x04, (_switches >> id) & 1});
+            if (_events)
+                event(out, sysex::Switch, id, (_switches >> id) & 1);
+        }
+        return out.size();
+    }
+
+private:
+    static void push(std::vector<std::byte>& out, std::initializer_list<int> msg)
+    {
+        for (int b : msg)
+            out.push_back(std::byte(b));
+    }
+    static void event(std::vector<std::byte>& out, int kind, int id, int value)
+    {
+        uint32_t t = board_time();
+        push(out, {0xF0, 0x70, 0x7D, sysex::Event, kind, id, (value >> 7) & 0x7F, value & 0x7F,
+                   int(t >> 21) & 0x7F, int(t >> 14) & 0x7F, int(t >> 7) & 0x7F, int(t) & 0x7F, 0xF7});
+    }
+
+    double           _exprs;
+    bool             _events;
+    std::minstd_rand _rng;
+    uint8_t          _switches = 0;
+    uint16_t         _sweep[2] = {0, 0};
+};
+
+/** Replay messages of a raw capture, looping over it **/
+class replay {
+public:
+    bool load(const std::string& path)
+    {
+        std::vector<char> raw;
+        sfx::io::capture_reader capture;
+        if (sfx::io::capture_reader::result::Ok == capture.open(path))
+        {
+            /* capture of the bridge, its chunks are the raw stream */
+            for (auto r = capture.next(); r; r = capture.next())
+                if (sfx::io::capture_format::Chunk == r->kind)
+                {
+                    auto bytes = std::span(reinterpret_cast<const char*>(r->payload.data()), r->payload.size());
+                    raw.insert(raw.end(), bytes.begin(), bytes.end());
+                }
+        }
+        else
+        {
+            std::ifstream file(path, std::ios::binary);
+            if (!file)
+                return false;
+            raw.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+
+        sfx::midi::parser parser(sfx::midi::protocol(), raw.size() + 1);
+        parser.feed(std::as_bytes(std::span(raw)), [this](const sfx::midi::message& msg)
+            { _messages.push_back(msg); });
+        return !_messages.empty();
+    }
+
+    std::size_t operator() (std::vector<std::byte>& out)
+    {
+        std::byte buffer[sfx::midi::sysex_capacity + 2];
+        auto n = sfx::midi::encode(_messages[_next], buffer);
+        out.insert(out.end(), buffer, buffer + n);
+        _next = (_next + 1) % _messages.size();
+        return out.size();
+    }
+
+    std::size_t size() const { return _messages.size(); }
+
+private:
+    std::vector<sfx::midi::message> _messages;
+    std::size_t _next = 0;
+};
+
+}
+
+int main(int argc, char *const argv[])
+{
+    using namespace sfx;
+    using clock_type = std::chrono::steady_clock;
+
+    options opts;
+    if (!parse_options(argc, argv, opts))
+    {
+        usage();
+        return -1;
+    }
+
+    std::function<std::size_t(std::vector<std::byte>&)> generate = synthetic(opts.exprs, opts.events);
+    replay recorded;
+    if (!opts.replay.empty())
+    {
+        if (!recorded.load(opts.replay))
+        {
+            std::cerr << "Failed load capture " << opts.replay << std::endl;
+            return -1;
+        }
+        std::cerr << "Replaying " << recorded.size() << " messages" << std::endl;
+        generate = std::ref(recorded);
+    }
+
+    io::serial::config config;
+    config.port = opts.port;
+    config.baudrate = 115200;
+    config.tx_capacity = 1 << 16;
+
+    io::serial serial;
+    if (opts.port.empty())
+    {
+        auto link = io::pty::try_open();
+        if (!link || io::serial::result::Ok != serial.begin(std::move(link), config))
+        {
+            perror("Failed create pty");
+            return -1;
+        }
+    }
+    else if (io::serial::result::Ok != serial.begin(config))
+    {
+        perror("Failed open port");
+        return -1;
+    }
+    std::cout << "Emulating on " << serial.link()->name() << std::endl;
+
+    io::reactor loop;
+    loop.begin();
+
+    std::vector<std::byte> msg;
+    msg.reserve(midi::sysex_capacity + 2);
+    auto post = [&](std::vector<std::byte>& m) -> bool
+    {
+        if (io::serial::result::Ok != serial.post(m))
+            return false;
+        m.clear();
+        return true;
+    };
+
+    /** Presentation, as setup() does and as requested by the host **/
+    auto present = [&]()
+    {
+        std::byte buffer[midi::sysex_capacity + 2];
+        midi::message m = midi::command(sysex::Present);
+        for (const char* c = opts.name.c_str(); *c && m.size < midi::sysex_capacity; ++c)
+            m.data[m.size++] = std::byte(*c);
+        std::size_t n = midi::encode(m, buffer);
+        serial.post(std::span(buffer, n));
+    };
+    present();
+
+    std::size_t sent = 0, stalled = 0, received = 0;
+    auto start = clock_type::now() + std::chrono::milliseconds(opts.delay);
+    auto report = clock_type::now();
+    std::size_t last_sent = 0;
+
+    /** Host to board traffic is dropped, pings are answered **/
+    midi::static_parser host(midi::parser_capacity);
+    auto on_host = [&](const midi::message& m)
+    {
+        if (midi::is_command(m, sysex::Present))
+            return present();
+        if (midi::is_command(m, sysex::Baudrate) && midi::arguments(m).size() == 1)
+        {
+            uint8_t index = uint8_t(midi::arguments(m)[0]);
+            std::byte buffer[midi::sysex_capacity + 2];
+            std::size_t n = midi::encode(midi::command(sysex::Baudrate, {index}), buffer);
+            serial.post(std::span(buffer, n));
+            return;
+        }
+        if (!midi::is_command(m, sysex::Ping) || midi::arguments(m).size() != 1)
+            return;
+        uint32_t t = board_time();
+        midi::message pong = midi::command(sysex::Ping, {
+            uint8_t(midi::arguments(m)[0]),
+            uint8_t(t >> 21), uint8_t(t >> 14), uint8_t(t >> 7), uint8_t(t)});
+        std::byte buffer[midi::sysex_capacity + 2];
+        std::size_t n = midi::encode(pong, buffer);
+        serial.post(std::span(buffer, n));
+    };
+    loop.watch(serial.fd(), EPOLLIN, [&](uint32_t events)
+    {
+        if (!(events & EPOLLIN))
+            return;
+        serial.receive_buffered();
+        for (auto raw = serial.buffered(); !raw.empty(); raw = serial.buffered())
+        {
+            received += raw.size();
+            serial.consume(host.feed(raw, on_host));
+        }
+    });
+
+    /** Pace messages on a 1 ms tick **/
+    loop.every(std::chrono::milliseconds(1), [&](uint64_t)
+    {
+        auto now = clock_type::now();
+        if (now < start)
+            return;
+
+        double elapsed = std::chrono::duration<double>(now - start).count();
+        std::size_t due = std::size_t(elapsed * opts.rate);
+        if (opts.count != 0)
+            due = std::min(due, opts.count);
+
+        while (sent < due)
+        {
+            if (msg.empty())
+                generate(msg);
+            if (!post(msg))
+            {
+                stalled += 1;
+                break;
+            }
+            sent += 1;
+        }
+
+        if (std::chrono::seconds(1) <= now - report)
+        {
+            std::cerr << "sent " << sent - last_sent << " msg/s"
+                      << " queue " << serial.queue_depth()
+                      << " stalls " << stalled
+                      << " syscalls " << serial.stats().syscalls
+                      << " bytes/syscall " << serial.stats().bytes_per_syscall()
+                      << " received " << received << std::endl;
+            report = now;
+            last_sent = sent;
+        }
+        if (opts.count != 0 && opts.count <= sent && !serial.pending())
+            loop.stop();
+    });
+
+    bool writing = false;
+    loop.after_dispatch([&]()
+    {
+        if (serial.pending() && io::serial::result::Failed == serial.transmit().first)
+        {
+            perror("Send failure");
+            loop.stop();
+            return;
+        }
+        if (writing != serial.pending())
+        {
+            writing = serial.pending();
+            loop.modify(serial.fd(), writing ? EPOLLIN | EPOLLOUT : EPOLLIN);
+        }
+    });
+
+    loop.run();
+    std::cerr << "sent " << sent << " messages" << std::endl;
+    return 0;
+}
@@ -0,0 +1,215 @@
+/**
+ * Replay of a capture written by the bridge, see io::capture.
+ *
+ * Raw chunks are fed through io::parser, either at the recorded pace or
+ *  as fast as possible, and the messages parsed are checked against the
+ *  ones the bridge parsed when capturing. The fast run reports parser
+ *  throughput on real traffic.
+ *
+ * With --pty the chunks are also written to a pty pair, so the bridge can
+ *  be run on recorded traffic : 5FX-Pedalboard <slave> 115200
+ * Playback then starts on the first bytes sent by the bridge, its
+ *  presentation query, and the board replies recorded are played as they
+ *  came.
+ */
+#include "capture.hpp"
+#include "transport.hpp"
+#include "midi.hpp"
+
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+
+#include <poll.h>
+#include <unistd.h>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+using namespace sfx;
+
+void usage()
+{
+    std::cout << "5FX-Replay capture [--fast | --speed ratio] [--from s] [--pty] [--loops n]" << std::endl;
+}
+
+struct options {
+    std::string path;
+    bool        fast = false;     /**< No pacing */
+    double      speed = 1;        /**< Pace ratio to the recorded one */
+    double      from = 0;         /**< Start offset in the capture, in s */
+    bool        pty = false;      /**< Write chunks to a pty for the bridge */
+    std::size_t loops = 1;
+};
+
+bool parse_options(int argc, char *const argv[], options& opts)
+{
+    if (argc < 2)
+        return false;
+    opts.path = argv[1];
+    for (int i = 2; i < argc; ++i)
+    {
+        auto arg = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+        const char* v = nullptr;
+        if (0 == strcmp(argv[i], "--fast"))
+            opts.fast = true;
+        else if (0 == strcmp(argv[i], "--speed") && (v = arg()))
+            opts.speed = std::atof(v);
+        else if (0 == strcmp(argv[i], "--from") && (v = arg()))
+            opts.from = std::atof(v);
+        else if (0 == strcmp(argv[i], "--pty"))
+            opts.pty = true;
+        else if (0 == strcmp(argv[i], "--loops") && (v = arg()))
+            opts.loops = std::max(1, std::atoi(v));
+        else
+            return false;
+    }
+    return 0 < opts.speed;
+}
+
+/** Block until the bridge opened the slave side and sent something **/
+void wait_host(int fd)
+{
+    pollfd pfd{fd, POLLIN, 0};
+    std::byte sink[256];
+    while (0 < poll(&pfd, 1, -1))
+        if (0 < read(fd, sink, sizeof(sink)))
+            return;
+}
+
+/** Chunk of a capture, and the messages the bridge parsed out of it **/
+struct chunk {
+    int64_t                    time;
+    std::span<const std::byte> bytes;
+    std::size_t                first;  /**< In the recorded messages */
+    std::size_t                count;
+};
+
+/**
+ * Parse every chunk and compare with the recorded messages, chunk per
+ *  chunk so a message cut at the start of the replay shifts nothing.
+ * Returns mismatching chunks.
+ */
+std::size_t check(const std::vector<chunk>& chunks, const std::vector<std::span<const std::byte>>& recorded)
+{
+    midi::parser parser(midi::protocol(), midi::parser_capacity);
+    std::size_t mismatches = 0;
+    for (const auto& c : chunks)
+    {
+        std::size_t seen = 0;
+        bool same = true;
+        parser.feed(c.bytes, [&](const midi::message& msg)
+        {
+            std::byte buffer[midi::sysex_capacity + 2];
+            std::size_t n = midi::encode(msg, buffer);
+            if (seen < c.count)
+            {
+                auto e = recorded[c.first + seen];
+                same = same && e.size() == n && 0 == std::memcmp(e.data(), buffer, n);
+            }
+            ++seen;
+        });
+        mismatches += !same || seen != c.count;
+    }
+    return mismatches;
+}
+
+}
+
+int main(int argc, char *const argv[])
+{
+    options opts;
+    if (!parse_options(argc, argv, opts))
+    {
+        usage();
+        return -1;
+    }
+
+    io::capture_reader capture;
+    if (io::capture_reader::result::Ok != capture.open(opts.path))
+    {
+        std::cerr << "Failed open capture " << opts.path << std::endl;
+        return -1;
+    }
+    std::cout << capture.records() << " records, " << capture.size() << " bytes" << std::endl;
+
+    std::unique_ptr<io::pty> link;
+    if (opts.pty)
+    {
+        link = io::pty::try_open();
+        if (!link)
+        {
+            perror("Failed create pty");
+            return -1;
+        }
+        std::cout << "Replaying on " << link->peer() << std::endl;
+        wait_host(link->fd());
+    }
+
+    /* offsets are taken from the first record */
+    int64_t from = 0;
+    if (auto first = capture.next())
+        from = first->time + int64_t(opts.from * 1e9);
+    capture.rewind();
+
+    std::vector<chunk> chunks;
+    std::vector<std::span<const std::byte>> recorded;
+    if (0 < opts.from && !capture.seek(from))
+        capture.rewind();
+    for (auto r = capture.next(); r; r = capture.next())
+    {
+        if (r->time < from)
+            continue;
+        if (io::capture_format::Chunk == r->kind)
+            chunks.push_back({r->time, r->payload, recorded.size(), 0});
+        else if (io::capture_format::Message == r->kind && !chunks.empty())
+        {
+            recorded.push_back(r->payload);
+            chunks.back().count += 1;
+        }
+    }
+    std::size_t bytes = 0;
+    for (const auto& c : chunks)
+        bytes += c.bytes.size();
+    std::size_t mismatches = check(chunks, recorded);
+    std::cout << chunks.size() << " chunks, " << bytes << " bytes, "
+              << recorded.size() << " messages, "
+              << mismatches << " chunks parsed differently" << std::endl;
+
+    midi::parser parser(midi::protocol(), midi::parser_capacity);
+    std::size_t parsed = 0;
+    auto sink = [&parsed](const midi::message&) { ++parsed; };
+    int64_t late = 0; /**< Worst pacing, in ns */
+
+    auto t0 = clock_type::now();
+    for (std::size_t loop = 0; loop < opts.loops; ++loop)
+    {
+        auto start = clock_type::now();
+        for (const auto& c : chunks)
+        {
+            if (!opts.fast)
+            {
+                auto due = start + std::chrono::nanoseconds(int64_t((c.time - chunks.front().time) / opts.speed));
+                std::this_thread::sleep_until(due);
+                late = std::max<int64_t>(late,
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - due).count());
+            }
+            if (link && ssize_t(c.bytes.size()) != write(link->fd(), c.bytes.data(), c.bytes.size()))
+                perror("write");
+            parser.feed(c.bytes, sink);
+        }
+    }
+    double dt = std::chrono::duration<double>(clock_type::now() - t0).count();
+
+    std::cout << "Replay : " << opts.loops << " x " << bytes << " bytes in " << dt << "s, ";
+    if (opts.fast)
+        std::cout << opts.loops * bytes / dt / 1e6 << " MB/s " << parsed / dt / 1e6 << " Mmsg/s";
+    else
+        std::cout << "pacing late by " << late / 1000. << "us at most";
+    std::cout << std::endl;
+    return 0 == mismatches ? 0 : 1;
+}